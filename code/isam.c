@@ -8,12 +8,85 @@
 #include <limits.h>
 #include <time.h>
 #include <unistd.h>
+#include <pthread.h>
+
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Prefetch e uma dica: um endereco alem do fim do vetor nao gera falha
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#define TRAILING_ZEROS(x) __builtin_ctzl(x)
+#define POPCOUNT(x) __builtin_popcountll(x)
+#else
+#define PREFETCH(address) ((void)0)
+#define TRAILING_ZEROS(x) trailingZeros(x)
+#define POPCOUNT(x) popcount(x)
+static int trailingZeros(unsigned long x)
+{
+    int count = 0;
+    while (!(x & 1))
+    {
+        x >>= 1;
+        count++;
+    }
+    return count;
+}
+static int popcount(unsigned long long x)
+{
+    int count = 0;
+    for (; x; x &= x - 1)
+        count++;
+    return count;
+}
+#endif
 
 #define MEMORY_LIMIT 10000
+#define CSV_CHUNK_SIZE (4 * 1024 * 1024)
+#define MERGE_FAN_IN 64
+#define RADIX_SORT_MIN 256
+#define MANIFEST_VERSION 2
+#define MAX_SPILL_DIRS 8
+#define RUN_PATH_MAX 512
+#define RESIDENT_INDEX_LIMIT (64L * 1024 * 1024)
+#define PLA_EPSILON 64
+#define BLOOM_BITS_PER_KEY 10
+#define BLOOM_HASHES 7
+#define BITMAP_FIELDS 5
+#define ROARING_ARRAY_MAX 4096
+#define ROARING_WORDS 1024
+#define ROARING_OVERFLOW_BASE 0x80000000u
+#define ROARING_AND 0
+#define ROARING_OR 1
+#define ROARING_ANDNOT 2
+#define BPT_PAGE_SIZE 4096
+#define BPT_FANOUT ((BPT_PAGE_SIZE - 2 * sizeof(long)) / (sizeof(long long) + sizeof(long)))
+#define BPT_PAGE_ENTRIES (BPT_FANOUT - 1) // Uma posicao fica livre para a insercao que divide a pagina
+#define BPT_MAX_HEIGHT 16
+#define BPT_MAGIC 0x42505431
+#define MANIFEST_SAMPLE_BYTES (64 * 1024)
+#define RUN_READ_BUFFER (256 * 1024)
 #define HASH_SIZE 50000
+#define ACTIVE_FLAG '+'
 #define REMOVED_FLAG '*'
+#define FREE_FLAG '\0'
+#define DICTIONARY_FIELDS 4
+#define DICTIONARY_ENTRIES 256
+#define DICTIONARY_VALUE 32
+#define DATE_TEXT_SIZE 32
 #define REBUILD_THRESHOLD 10
-#define BLOCK_SIZE 100
+#define PAGE_FILL_PERCENT 90
+#define PRODUCT_LOG_FRACTION 4 // Log do indice de produto compactado ao passar de 1/4 dos registros
 
 int removal_count = 0;
 
@@ -21,35 +94,56 @@ int removal_count = 0;
    Typedefs / Structs
    ----------------------- */
 
+// Registro gravado em disco (56 bytes): data em segundos, preco em centavos e os textos
+// como codigos dos dicionarios. O texto so e montado na leitura do CSV e na exibicao.
 typedef struct
 {
-    char data[30];
+    long long int date; // Segundos desde 1970 (UTC); -1 se invalida
     long long int order_id;
     long long int product_id;
-    int quantity;
     long long int category_id;
-    char category_alias[30];
-    int brand_id;
-    float price_usd;
     long long int user_id;
+    int quantity;
+    int price_cents;
+    short brand_id;
+    char status; // ACTIVE_FLAG, REMOVED_FLAG ou FREE_FLAG
     char product_gender;
-    char color[10];
-    char metal[10];
-    char gem[25];
+    unsigned char category_alias; // Codigos nos dicionarios (0 = vazio)
+    unsigned char color;
+    unsigned char metal;
+    unsigned char gem;
 } ORDER;
 
 typedef struct
 {
     long long int product_id;
     long long int category_id;
-    int brand_id;
-    float price_usd;
+    int price_cents;
+    short brand_id;
     char product_gender;
-    char color[10];
-    char metal[10];
-    char gem[25];
+    unsigned char color;
+    unsigned char metal;
+    unsigned char gem;
 } JEWELRY;
 
+typedef enum
+{
+    DICT_CATEGORY,
+    DICT_COLOR,
+    DICT_METAL,
+    DICT_GEM
+} DICTIONARY_FIELD;
+
+// Valores de texto de ORDER e JEWELRY; o codigo 0 e sempre o texto vazio
+typedef struct
+{
+    int counts[DICTIONARY_FIELDS];
+    char values[DICTIONARY_FIELDS][DICTIONARY_ENTRIES][DICTIONARY_VALUE];
+    int dirty;
+} DICTIONARIES;
+
+DICTIONARIES dictionaries = {.counts = {1, 1, 1, 1}};
+
 typedef struct
 {
     long long int category_id;
@@ -92,6 +186,12 @@ typedef struct
     int total_quantity;
 } PRODUCT_SALES;
 
+typedef struct
+{
+    long long key;
+    long slot; // Posicao da chave no vetor do chamador
+} BATCH_PROBE;
+
 typedef struct
 {
     int year;
@@ -101,6 +201,380 @@ typedef struct
     float total_revenue;
 } MONTHLY_SALES;
 
+typedef struct
+{
+    long long key;
+    int slot; // Posicao do registro no buffer original
+} KEY_SLOT;
+
+typedef enum
+{
+    RUN_STRATEGY_SORT,       // Enche o buffer, ordena e grava (runs de MEMORY_LIMIT registros)
+    RUN_STRATEGY_REPLACEMENT // Selecao por substituicao (runs ~2x maiores)
+} RUN_STRATEGY;
+
+typedef struct
+{
+    int run;
+    long long key;
+    int slot; // Posicao do registro no buffer
+} RS_ENTRY;
+
+typedef struct
+{
+    const char *prefix; // temp_<prefix>_run_<n>.dat
+    size_t recordSize;
+    size_t keyOffset;
+    char *buffer;
+    long count;
+    char *spareBuffer;   // Buffer reserva preenchido enquanto o outro e gravado
+    char *pendingBuffer; // Buffer sendo ordenado/gravado pela thread de escrita
+    long pendingCount;
+    pthread_t writer;
+    int writerActive;
+    int *runCounter; // Contador de runs compartilhado entre workers
+    RS_ENTRY *heap;  // Somente RUN_STRATEGY_REPLACEMENT
+    int currentRun;
+    long long lastKey;
+    FILE *runFile;
+    int runNumber;
+    long runLength;
+    int runsCreated;
+    long recordsSpilled;
+} RUN_BUILDER;
+
+typedef struct
+{
+    const char *data;
+    size_t size;
+    int mapped; // 1 = mmap, 0 = buffer alocado
+} CSV_MAP;
+
+typedef struct
+{
+    const char *data; // Aponta para dentro do CSV_MAP
+    size_t length;
+} CSV_CHUNK;
+
+typedef struct
+{
+    CSV_CHUNK *chunks;
+    int capacity;
+    int head;
+    int count;
+    int closed;
+    pthread_mutex_t mutex;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+} CHUNK_QUEUE;
+
+typedef struct
+{
+    RUN_BUILDER orders;
+    RUN_BUILDER jewelry;
+    CategoryNode **categoryHash;
+    CHUNK_QUEUE *queue;
+} INGEST_WORKER;
+
+typedef struct
+{
+    FILE *file;
+    char *buffer;
+    size_t recordSize;
+    long capacity; // Registros que cabem no buffer
+    long count;    // Registros lidos no buffer
+    long pos;      // Proximo registro do buffer
+    int finished;
+} RUN_READER;
+
+typedef struct
+{
+    RUN_READER *readers;
+    int k;
+    int *tree; // tree[0] = vencedor atual, tree[1..k-1] = perdedores
+    size_t keyOffset;
+} LOSER_TREE;
+
+typedef struct
+{
+    int ingestThreads; // Workers de parsing/ordenacao na carga do CSV
+    int mergeFanIn;    // Maximo de runs abertos em uma passada de merge
+    RUN_STRATEGY runStrategy;
+    int benchSort;  // --bench-sort: roda o benchmark de ordenacao e sai
+    int benchSearch; // --bench-search: roda o benchmark de busca no indice e sai
+    int asyncSpill; // Grava os runs em segundo plano (buffer duplo)
+    int forceRebuild; // --rebuild: ignora o manifesto e recarrega o CSV
+    const char *spillDirs[MAX_SPILL_DIRS]; // Diretorios dos runs temporarios (--spill-dir)
+    int numSpillDirs;
+    int learnedIndex; // --learned-index: busca de ordens pelo indice aprendido (orderIndex.pla)
+    int columnar;     // --columnar: mantem colunas de orderHistory para as agregacoes
+} CONFIG;
+
+CONFIG config = {1, MERGE_FAN_IN, RUN_STRATEGY_SORT, 0, 0, 1, 0, {"../data"}, 1, 0, 0};
+
+typedef struct
+{
+    int version;
+    int clean; // 0 enquanto o programa esta com os arquivos abertos
+    int orderSize;
+    int jewelrySize;
+    int categorySize;
+    int indexSize;
+    int overflowSize;
+    int indexGap;
+    long orderCount;
+    long jewelryCount;
+    long categoryCount;
+    long overflowCount;
+    long long csvSize;
+    long long csvMtime;
+    // orderHistory, orderIndex, jewelryRegister, jewelryIndex, categoryRegister, categoryIndex, orderOverflow, dictionaries
+    unsigned long long checksums[8];
+} MANIFEST;
+
+// Pagina do B+tree: nas folhas values[] sao posicoes no arquivo de dados,
+// nos nos internos sao paginas filhas e keys[i] e a menor chave da filha i
+typedef struct
+{
+    int leaf;
+    int count;
+    long next; // Proxima folha (-1 na ultima)
+    long long keys[BPT_FANOUT];
+    long values[BPT_FANOUT];
+} BPT_PAGE;
+
+// Pagina 0 do arquivo .bpt
+typedef struct
+{
+    int magic;
+    int height; // 0 = vazio, 1 = raiz e folha
+    long root;
+    long pageCount;
+    long entryCount;
+} BPT_META;
+
+typedef struct
+{
+    FILE *file;
+    BPT_META meta;
+    BPT_PAGE **cache; // Nos internos fixados em memoria, indexados pelo numero da pagina
+    long cacheSize;
+} BPTREE;
+
+// Estado de um indice esparso aberto: copia residente do .idx e o B+tree em disco
+typedef struct
+{
+    int isOpen;
+    INDEX *entries; // NULL quando o .idx passa de RESIDENT_INDEX_LIMIT
+    long count;
+    long capacity;
+    long long *eytzKeys; // Chaves em ordem de Eytzinger (BFS), posicoes 1..count
+    long *eytzPositions;
+    BPTREE tree;
+} SPARSE_INDEX;
+
+SPARSE_INDEX orderSparse = {0};
+SPARSE_INDEX jewelrySparse = {0};
+SPARSE_INDEX categorySparse = {0};
+
+typedef struct
+{
+    long long firstKey;
+    long firstRank; // Registro da primeira ocorrencia de firstKey
+    double slope;   // Registros por unidade de order_id
+} PLA_SEGMENT;
+
+typedef struct
+{
+    PLA_SEGMENT *segments;
+    int count;
+    int capacity;
+    long recordCount; // Registros de orderHistory.dat cobertos pelo ajuste
+    long long maxKey;
+    unsigned long long checksum; // streamChecksum de orderHistory.dat no ajuste
+} LEARNED_INDEX;
+
+typedef struct
+{
+    LEARNED_INDEX *index;
+    long long startKey;
+    long startRank;
+    double slopeLow;
+    double slopeHigh; // < 0 enquanto o segmento tem um ponto so
+    long long lastKey;
+    long points;
+} PLA_BUILDER;
+
+LEARNED_INDEX learnedIndex = {0};
+
+typedef struct
+{
+    long blockPos; // Posicao do bloco (entrada do indice de ordens)
+    long head;     // Offset do registro de overflow mais recente do bloco
+} OVERFLOW_HEAD;
+
+// Cabecas das listas de overflow por bloco, ordenadas por blockPos
+typedef struct
+{
+    int isOpen;
+    FILE *file;
+    OVERFLOW_HEAD *heads;
+    long count;
+    long capacity;
+} OVERFLOW_CHAINS;
+
+OVERFLOW_CHAINS overflowChains = {0};
+
+// Filtros de Bloom dos blocos de ordens, contiguos: bloco b ocupa bits[b * wordsPerBlock ...]
+typedef struct
+{
+    unsigned long long *bits;
+    long blocks;
+    long wordsPerBlock;
+} BLOOM_FILTER;
+
+BLOOM_FILTER orderBloom = {0};
+
+typedef struct
+{
+    long long product_id;
+    long location; // Registro em orderHistory.dat (no log, < 0 = -(offset + 1) no overflow)
+} PRODUCT_POSTING;
+
+typedef struct
+{
+    long long product_id;
+    long offset; // Inicio da lista em postings
+    long count;
+} PRODUCT_ENTRY;
+
+typedef struct
+{
+    PRODUCT_ENTRY *entries; // Ordenado por product_id
+    long count;
+    unsigned char *postings; // Registros de cada produto, diferencas em varint
+    long postingsSize;
+    long recordCount;
+    PRODUCT_POSTING *pending; // Pares coletados durante o merge
+    long pendingCount;
+    long pendingCapacity;
+    PRODUCT_POSTING *log; // Ordens inseridas depois do merge
+    long logCount;
+} PRODUCT_INDEX;
+
+PRODUCT_INDEX productIndex = {0};
+
+// Datas em segundos desde 1970 (data vazia ou invalida fica fora de min/maxDate)
+typedef struct
+{
+    long long minDate, maxDate;
+    long long minProduct, maxProduct;
+    long long minCategory, maxCategory;
+    long long minUser, maxUser;
+    float minPrice, maxPrice;
+} ZONE_MAP;
+
+typedef struct
+{
+    ZONE_MAP *zones; // Um por bloco do indice de ordens
+    long count;
+} ZONE_MAPS;
+
+ZONE_MAPS orderZones = {0};
+
+typedef struct
+{
+    long long fromDate, toDate;
+    long long category_id; // 0 = qualquer categoria
+    float minPrice, maxPrice;
+} ORDER_FILTER;
+
+// Container Roaring: os 16 bits baixos dos valores com a mesma parte alta (key)
+typedef struct
+{
+    unsigned short key;
+    int cardinality;
+    int capacity;
+    unsigned short *array;    // Ate ROARING_ARRAY_MAX valores ordenados
+    unsigned long long *bits; // Ou ROARING_WORDS palavras, quando o container e denso
+} ROARING_CONTAINER;
+
+typedef struct
+{
+    ROARING_CONTAINER *containers; // Ordenado por key
+    int count;
+    int capacity;
+} ROARING;
+
+typedef struct
+{
+    char value[32];
+    ROARING bitmap;
+} BITMAP_VALUE;
+
+typedef struct
+{
+    BITMAP_VALUE *values;
+    int count;
+    int capacity;
+} BITMAP_FIELD;
+
+// Ordinal = registro em orderHistory.dat, ou ROARING_OVERFLOW_BASE + registro no overflow
+typedef struct
+{
+    BITMAP_FIELD fields[BITMAP_FIELDS];
+    ROARING live; // Ordens ativas
+    long mainCount;
+    long overflowCount;
+    int dirty;
+} ORDER_BITMAPS;
+
+ORDER_BITMAPS orderBitmaps = {0};
+
+typedef struct
+{
+    ORDER record;
+    long sequence; // Desempata order_id iguais na ordem em que foram encontrados
+} CURSOR_PENDING;
+
+// Varredura de [lo, hi] em order_id: o trecho ordenado do arquivo e lido em sequencia;
+// a cauda (inserida no fim, fora de ordem) e o overflow entram ja filtrados e ordenados em pending
+typedef struct
+{
+    FILE *orderHistory;
+    long long lo, hi;
+    long position; // Proximo byte a ler do arquivo principal
+    long sortedEnd; // Inicio do ultimo bloco; dali em diante vai para pending
+    ORDER *buffer;
+    long count;
+    long index;
+    int mainDone;
+    CURSOR_PENDING *pending;
+    long pendingCount;
+    long pendingIndex;
+    long pendingCapacity;
+} ORDER_CURSOR;
+
+typedef enum
+{
+    COLUMN_STATUS,   // 1 = ordem ativa; 0 = removida ou slot livre
+    COLUMN_DATE,     // Segundos desde 1970 (-1 se invalida)
+    COLUMN_PRODUCT,
+    COLUMN_QUANTITY,
+    COLUMN_PRICE,
+    COLUMN_COUNT
+} ORDER_COLUMN;
+
+// Colunas de orderHistory.dat, um arquivo por campo, na mesma ordem dos registros
+typedef struct
+{
+    int isOpen;
+    int invalidated; // Modo colunar desligado: arquivos antigos ja apagados
+    FILE *files[COLUMN_COUNT];
+} COLUMN_STORE;
+
+COLUMN_STORE columnStore = {0};
+
 /* -----------------------
    Implementação
    ----------------------- */
@@ -117,6 +591,102 @@ FILE *openFile(const char *fileName, const char *mode)
     return file;
 }
 
+unsigned long long fnv1a(unsigned long long hash, const void *data, size_t length)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Checksum do arquivo inteiro (maxBytes = 0) ou so do inicio e do fim (maxBytes de cada lado).
+// A posicao do arquivo e preservada.
+unsigned long long streamChecksum(FILE *f, long *size, long maxBytes)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    long saved = ftell(f);
+
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char buffer[65536];
+    size_t n;
+    if (maxBytes == 0 || *size <= 2 * maxBytes)
+    {
+        while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+            hash = fnv1a(hash, buffer, n);
+    }
+    else
+    {
+        long remaining = maxBytes;
+        while (remaining > 0 && (n = fread(buffer, 1, remaining < (long)sizeof(buffer) ? remaining : (long)sizeof(buffer), f)) > 0)
+        {
+            hash = fnv1a(hash, buffer, n);
+            remaining -= n;
+        }
+
+        fseek(f, *size - maxBytes, SEEK_SET);
+        remaining = maxBytes;
+        while (remaining > 0 && (n = fread(buffer, 1, remaining < (long)sizeof(buffer) ? remaining : (long)sizeof(buffer), f)) > 0)
+        {
+            hash = fnv1a(hash, buffer, n);
+            remaining -= n;
+        }
+    }
+
+    fseek(f, saved, SEEK_SET);
+    return hash;
+}
+
+unsigned long long fileChecksum(const char *path, long *size, long maxBytes)
+{
+    *size = -1;
+
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return 0;
+
+    unsigned long long hash = streamChecksum(f, size, maxBytes);
+    fclose(f);
+    return hash;
+}
+
+// Arquivos de blocos de tamanho fixo com cabecalho (o primeiro long e o numero de blocos): regrava
+// so o bloco block e os que foram acrescentados desde a ultima gravacao, e atualiza o contador.
+// Retorna 0 se o cabecalho gravado nao confere com header; o chamador regrava o arquivo inteiro.
+int saveFileBlocks(const char *path, const long *header, size_t headerBytes, const void *data,
+                   size_t blockBytes, long block, long blocks)
+{
+    long saved[4];
+    FILE *f = fopen(path, "rb+");
+    int ok = f && headerBytes <= sizeof(saved) && fread(saved, headerBytes, 1, f) == 1 &&
+             saved[0] <= blocks &&
+             (headerBytes == sizeof(long) || memcmp(saved + 1, header + 1, headerBytes - sizeof(long)) == 0);
+    if (!ok)
+    {
+        if (f)
+            fclose(f);
+        return 0;
+    }
+
+    const char *bytes = (const char *)data;
+    fseek(f, headerBytes + block * blockBytes, SEEK_SET);
+    fwrite(bytes + block * blockBytes, blockBytes, 1, f);
+    if (blocks > saved[0])
+    {
+        fseek(f, headerBytes + saved[0] * blockBytes, SEEK_SET);
+        fwrite(bytes + saved[0] * blockBytes, blockBytes, blocks - saved[0], f);
+        fseek(f, 0, SEEK_SET);
+        fwrite(&blocks, sizeof(long), 1, f);
+    }
+    fclose(f);
+    return 1;
+}
+
 // --------------------------------------- Quick Sort -----------------------------------------
 int compareOrders(const void *a, const void *b)
 {
@@ -163,6 +733,12 @@ int compareCategorySales(const void *a, const void *b)
     return 0;
 }
 
+int compareLongs(const void *a, const void *b)
+{
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
 int compareSales(const void *a, const void *b)
 {
     PRODUCT_SALES *saleA = (PRODUCT_SALES *)a;
@@ -230,1572 +806,6237 @@ void quicksort(void *buffer, long count, size_t size, int (*compare)(const void
     qsortRecursive((char *)buffer, size, compare, 0, count - 1);
 }
 
+long long recordKey(const void *record, size_t keyOffset)
+{
+    long long key;
+    memcpy(&key, (const char *)record + keyOffset, sizeof(key));
+    return key;
+}
 
-// -------------------------- Separar linhas do arquivo e salvar nos .dat referentes -----------------
-int parseCSVLine(char *line, ORDER *order)
+// ------------------------------ Ordenacao por chave (tag sort) ------------------------------
+// Em vez de trocar registros inteiros (ORDER tem ~180 bytes), ordena pares (chave, slot) de
+// 16 bytes com introsort e depois permuta os registros uma unica vez seguindo os ciclos.
+
+int keySlotLess(const KEY_SLOT *a, const KEY_SLOT *b)
 {
-    char *ptr = line;
-    int field = 0;
-    char buffer[256];
-    int bufIdx = 0;
+    if (a->key != b->key)
+        return a->key < b->key;
+    return a->slot < b->slot;
+}
 
-    while (*ptr)
+void insertionSortKeys(KEY_SLOT *tags, long count)
+{
+    for (long i = 1; i < count; i++)
     {
-        if (*ptr == ',' || *ptr == '\n' || *ptr == '\r')
+        KEY_SLOT current = tags[i];
+        long j = i - 1;
+        while (j >= 0 && keySlotLess(&current, &tags[j]))
         {
-            buffer[bufIdx] = '\0';
-
-            switch (field)
-            {
-            case 0:
-                strncpy(order->data, buffer, sizeof(order->data) - 1);
-                break;
-            case 1:
-                order->order_id = atoll(buffer);
-                break;
-            case 2:
-                order->product_id = atoll(buffer);
-                break;
-            case 3:
-                order->quantity = atoi(buffer);
-                break;
-            case 4:
-                order->category_id = atoll(buffer);
-                break;
-            case 5:
-                strncpy(order->category_alias, buffer, sizeof(order->category_alias) - 1);
-                break;
-            case 6:
-                order->brand_id = atoi(buffer);
-                break;
-            case 7:
-                order->price_usd = atof(buffer);
-                break;
-            case 8:
-                order->user_id = atoll(buffer);
-                break;
-            case 9:
-                order->product_gender = buffer[0];
-                break;
-            case 10:
-                strncpy(order->color, buffer, sizeof(order->color) - 1);
-                break;
-            case 11:
-                strncpy(order->metal, buffer, sizeof(order->metal) - 1);
-                break;
-            case 12:
-                strncpy(order->gem, buffer, sizeof(order->gem) - 1);
-                break;
-            }
-
-            field++;
-            bufIdx = 0;
-            ptr++;
-            continue;
+            tags[j + 1] = tags[j];
+            j--;
         }
-        buffer[bufIdx++] = *ptr++;
+        tags[j + 1] = current;
     }
-
-    return field > 0;
 }
 
-int createSortedRuns(FILE *csv, int *numOrderRuns, int *numJewelryRuns, int *numCategoryRuns)
+void siftDownKeys(KEY_SLOT *tags, long count, long i)
 {
-    char line[200];
-    ORDER *orderBuffer = malloc(MEMORY_LIMIT * sizeof(ORDER));
-    JEWELRY *jewelryBuffer = malloc(MEMORY_LIMIT * sizeof(JEWELRY));
-
-    CategoryNode **categoryHash = calloc(1000, sizeof(CategoryNode *));
-
-    int orderCount = 0;
-    int jewelryCount = 0;
-    int orderRunNum = 0;
-    int jewelryRunNum = 0;
-
-    while (fgets(line, sizeof(line), csv) != NULL)
+    while (1)
     {
-        ORDER order;
-        if (!parseCSVLine(line, &order))
-            continue;
+        long largest = i;
+        long left = 2 * i + 1;
+        long right = left + 1;
+
+        if (left < count && keySlotLess(&tags[largest], &tags[left]))
+            largest = left;
+        if (right < count && keySlotLess(&tags[largest], &tags[right]))
+            largest = right;
+        if (largest == i)
+            return;
+
+        KEY_SLOT temp = tags[i];
+        tags[i] = tags[largest];
+        tags[largest] = temp;
+        i = largest;
+    }
+}
 
-        orderBuffer[orderCount++] = order;
+void heapSortKeys(KEY_SLOT *tags, long count)
+{
+    for (long i = count / 2 - 1; i >= 0; i--)
+        siftDownKeys(tags, count, i);
 
-        JEWELRY jewelry;
-        jewelry.product_id = order.product_id;
-        jewelry.category_id = order.category_id;
-        jewelry.brand_id = order.brand_id;
-        jewelry.price_usd = order.price_usd;
-        jewelry.product_gender = order.product_gender;
-        strncpy(jewelry.color, order.color, sizeof(jewelry.color) - 1);
-        strncpy(jewelry.metal, order.metal, sizeof(jewelry.metal) - 1);
-        strncpy(jewelry.gem, order.gem, sizeof(jewelry.gem) - 1);
+    for (long end = count - 1; end > 0; end--)
+    {
+        KEY_SLOT temp = tags[0];
+        tags[0] = tags[end];
+        tags[end] = temp;
+        siftDownKeys(tags, end, 0);
+    }
+}
 
-        jewelryBuffer[jewelryCount++] = jewelry;
+void introsortKeys(KEY_SLOT *tags, long count, int depthLimit)
+{
+    while (count > 16)
+    {
+        if (depthLimit-- == 0)
+        {
+            heapSortKeys(tags, count);
+            return;
+        }
 
-        int hashIdx = order.category_id % 1000;
-        CategoryNode *current = categoryHash[hashIdx];
-        CategoryNode *found = NULL;
+        // Pivo pela mediana de tres (evita o pior caso em entradas ja ordenadas)
+        long mid = count / 2;
+        if (keySlotLess(&tags[mid], &tags[0]))
+        {
+            KEY_SLOT t = tags[mid]; tags[mid] = tags[0]; tags[0] = t;
+        }
+        if (keySlotLess(&tags[count - 1], &tags[0]))
+        {
+            KEY_SLOT t = tags[count - 1]; tags[count - 1] = tags[0]; tags[0] = t;
+        }
+        if (keySlotLess(&tags[count - 1], &tags[mid]))
+        {
+            KEY_SLOT t = tags[count - 1]; tags[count - 1] = tags[mid]; tags[mid] = t;
+        }
+        KEY_SLOT pivot = tags[mid];
 
-        while (current)
+        long i = 0;
+        long j = count - 1;
+        while (1)
         {
-            if (current->data.category_id == order.category_id)
-            {
-                found = current;
+            while (keySlotLess(&tags[i], &pivot))
+                i++;
+            while (keySlotLess(&pivot, &tags[j]))
+                j--;
+            if (i >= j)
                 break;
-            }
-            current = current->next;
+            KEY_SLOT t = tags[i];
+            tags[i] = tags[j];
+            tags[j] = t;
+            i++;
+            j--;
         }
 
-        if (found)
+        // Recursao na parte menor, laco na maior
+        long leftCount = j + 1;
+        if (leftCount < count - leftCount)
         {
-            found->data.total_sales += order.quantity;
-            found->data.total_revenue += (order.price_usd * order.quantity);
+            introsortKeys(tags, leftCount, depthLimit);
+            tags += leftCount;
+            count -= leftCount;
         }
         else
         {
-            CategoryNode *newNode = malloc(sizeof(CategoryNode));
-            newNode->data.category_id = order.category_id;
-            strncpy(newNode->data.category_alias, order.category_alias, sizeof(newNode->data.category_alias) - 1);
-            newNode->data.product_count = 0;
-            newNode->data.total_sales = order.quantity;
-            newNode->data.total_revenue = (order.price_usd * order.quantity);
-            newNode->next = categoryHash[hashIdx];
-            categoryHash[hashIdx] = newNode;
+            introsortKeys(tags + leftCount, count - leftCount, depthLimit);
+            count = leftCount;
         }
+    }
 
-        if (orderCount >= MEMORY_LIMIT)
-        {
-            quicksort(orderBuffer, orderCount, sizeof(ORDER), compareOrders);
-            char filename[50];
-            sprintf(filename, "../data/temp_order_run_%d.dat", orderRunNum);
-            FILE *f = fopen(filename, "wb");
-            fwrite(orderBuffer, sizeof(ORDER), orderCount, f);
-            fclose(f);
-            orderRunNum++;
-            orderCount = 0;
-
-            quicksort(jewelryBuffer, jewelryCount, sizeof(JEWELRY), compareJewelry);
-            sprintf(filename, "../data/temp_jewelry_run_%d.dat", jewelryRunNum);
-            f = fopen(filename, "wb");
-            fwrite(jewelryBuffer, sizeof(JEWELRY), jewelryCount, f);
-            fclose(f);
-            jewelryRunNum++;
-            jewelryCount = 0;
+    insertionSortKeys(tags, count);
+}
 
-            printf("  Runs %d criados\n", orderRunNum);
-        }
-    }
+// Radix sort LSD de 8 bits para pares (chave, slot). Os 8 histogramas sao montados em uma
+// passada; bytes iguais em todas as chaves (comum nos ids, que compartilham o prefixo)
+// pulam a passada correspondente. O sort e estavel, entao empates ficam na ordem do slot.
+void radixSortKeys(KEY_SLOT *tags, long count)
+{
+    if (count <= 1)
+        return;
 
-    if (orderCount > 0)
-    {
-        quicksort(orderBuffer, orderCount, sizeof(ORDER), compareOrders);
-        char filename[50];
-        sprintf(filename, "../data/temp_order_run_%d.dat", orderRunNum);
-        FILE *f = fopen(filename, "wb");
-        fwrite(orderBuffer, sizeof(ORDER), orderCount, f);
-        fclose(f);
-        orderRunNum++;
-    }
+    long (*histogram)[256] = calloc(8, sizeof(*histogram));
+    KEY_SLOT *temp = malloc(count * sizeof(KEY_SLOT));
 
-    if (jewelryCount > 0)
+    for (long i = 0; i < count; i++)
     {
-        quicksort(jewelryBuffer, jewelryCount, sizeof(JEWELRY), compareJewelry);
-        char filename[50];
-        sprintf(filename, "../data/temp_jewelry_run_%d.dat", jewelryRunNum);
-        FILE *f = fopen(filename, "wb");
-        fwrite(jewelryBuffer, sizeof(JEWELRY), jewelryCount, f);
-        fclose(f);
-        jewelryRunNum++;
+        // Inverte o bit de sinal para que chaves negativas venham antes
+        unsigned long long key = (unsigned long long)tags[i].key ^ 0x8000000000000000ULL;
+        for (int pass = 0; pass < 8; pass++)
+            histogram[pass][(key >> (pass * 8)) & 0xFF]++;
     }
 
-    int categoryCount = 0;
-    CATEGORY *categoryBuffer = malloc(1000 * sizeof(CATEGORY));
+    KEY_SLOT *from = tags;
+    KEY_SLOT *to = temp;
 
-    for (int i = 0; i < 1000; i++)
+    for (int pass = 0; pass < 8; pass++)
     {
-        CategoryNode *current = categoryHash[i];
-        while (current)
+        int shift = pass * 8;
+        unsigned long long firstKey = (unsigned long long)from[0].key ^ 0x8000000000000000ULL;
+        if (histogram[pass][(firstKey >> shift) & 0xFF] == count)
+            continue;
+
+        long offset = 0;
+        for (int b = 0; b < 256; b++)
         {
-            categoryBuffer[categoryCount].category_id = current->data.category_id;
-            strncpy(categoryBuffer[categoryCount].category_alias, current->data.category_alias,
-                    sizeof(categoryBuffer[categoryCount].category_alias) - 1);
-            categoryBuffer[categoryCount].product_count = 0;
-            categoryBuffer[categoryCount].total_sales = current->data.total_sales;
-            categoryBuffer[categoryCount].total_revenue = current->data.total_revenue;
-            categoryCount++;
+            long c = histogram[pass][b];
+            histogram[pass][b] = offset;
+            offset += c;
+        }
 
-            CategoryNode *temp = current;
-            current = current->next;
-            free(temp);
+        for (long i = 0; i < count; i++)
+        {
+            unsigned long long key = (unsigned long long)from[i].key ^ 0x8000000000000000ULL;
+            to[histogram[pass][(key >> shift) & 0xFF]++] = from[i];
         }
-    }
 
-    if (categoryCount > 0)
-    {
-        quicksort(categoryBuffer, categoryCount, sizeof(CATEGORY), compareCategory);
-        FILE *f = fopen("../data/temp_category_run_0.dat", "wb");
-        fwrite(categoryBuffer, sizeof(CATEGORY), categoryCount, f);
-        fclose(f);
-        *numCategoryRuns = 1;
-    }
-    else
-    {
-        *numCategoryRuns = 0;
+        KEY_SLOT *swap = from;
+        from = to;
+        to = swap;
     }
 
-    free(orderBuffer);
-    free(jewelryBuffer);
-    free(categoryBuffer);
-    free(categoryHash);
+    if (from != tags)
+        memcpy(tags, from, count * sizeof(KEY_SLOT));
 
-    *numOrderRuns = orderRunNum;
-    *numJewelryRuns = jewelryRunNum;
-    return orderRunNum;
+    free(temp);
+    free(histogram);
 }
 
-int mergeOrderRuns(int numRuns, FILE *orderHistory, FILE *orderIndex, int indexGap)
+// Reordena os registros para que o registro tags[i].slot va para a posicao i
+void permuteRecords(char *buffer, size_t size, KEY_SLOT *tags, long count)
 {
-    FILE **runFiles = malloc(numRuns * sizeof(FILE *));
-    ORDER *currentOrders = malloc(numRuns * sizeof(ORDER));
-    int *runFinished = calloc(numRuns, sizeof(int));
-
-    for (int i = 0; i < numRuns; i++)
-    {
-        char filename[50];
-        sprintf(filename, "../data/temp_order_run_%d.dat", i);
-        runFiles[i] = fopen(filename, "rb");
-        if (fread(&currentOrders[i], sizeof(ORDER), 1, runFiles[i]) != 1)
-        {
-            runFinished[i] = 1;
-        }
-    }
-
-    const int WRITE_BUFFER_SIZE = 5000;
-    ORDER *writeBuffer = malloc(WRITE_BUFFER_SIZE * sizeof(ORDER));
-    int writeCount = 0;
-    long totalWritten = 0;
-    int indexCount = 0;
+    char *temp = malloc(size);
 
-    while (1)
+    for (long i = 0; i < count; i++)
     {
-        int minIndex = -1;
-        long long minOrderId = LLONG_MAX;
+        if (tags[i].slot == i)
+            continue;
 
-        for (int i = 0; i < numRuns; i++)
+        memcpy(temp, buffer + i * size, size);
+        long j = i;
+        while (1)
         {
-            if (!runFinished[i] && currentOrders[i].order_id < minOrderId)
+            long from = tags[j].slot;
+            tags[j].slot = j;
+            if (from == i)
             {
-                minOrderId = currentOrders[i].order_id;
-                minIndex = i;
+                memcpy(buffer + j * size, temp, size);
+                break;
             }
+            memcpy(buffer + j * size, buffer + from * size, size);
+            j = from;
         }
+    }
 
-        if (minIndex == -1)
-            break;
-
-        writeBuffer[writeCount++] = currentOrders[minIndex];
-
-        if (totalWritten % indexGap == 0)
-        {
-            INDEX indexEntry = {currentOrders[minIndex].order_id, totalWritten * sizeof(ORDER)};
-            fwrite(&indexEntry, sizeof(INDEX), 1, orderIndex);
-            indexCount++;
-        }
-
-        totalWritten++;
+    free(temp);
+}
 
-        if (writeCount >= WRITE_BUFFER_SIZE)
-        {
-            fwrite(writeBuffer, sizeof(ORDER), writeCount, orderHistory);
-            writeCount = 0;
-        }
+void sortRecordsByKeyUsing(void *buffer, long count, size_t size, size_t keyOffset, int useRadix)
+{
+    if (count <= 1)
+        return;
 
-        if (fread(&currentOrders[minIndex], sizeof(ORDER), 1, runFiles[minIndex]) != 1)
-        {
-            runFinished[minIndex] = 1;
-        }
+    KEY_SLOT *tags = malloc(count * sizeof(KEY_SLOT));
+    for (long i = 0; i < count; i++)
+    {
+        tags[i].key = recordKey((char *)buffer + i * size, keyOffset);
+        tags[i].slot = (int)i;
     }
 
-    if (writeCount > 0)
+    if (useRadix)
     {
-        fwrite(writeBuffer, sizeof(ORDER), writeCount, orderHistory);
+        radixSortKeys(tags, count);
     }
-
-    for (int i = 0; i < numRuns; i++)
+    else
     {
-        fclose(runFiles[i]);
-        char filename[50];
-        sprintf(filename, "../data/temp_order_run_%d.dat", i);
-        remove(filename);
+        int depthLimit = 0;
+        for (long n = count; n > 1; n >>= 1)
+            depthLimit += 2;
+        introsortKeys(tags, count, depthLimit);
     }
+    permuteRecords((char *)buffer, size, tags, count);
+    free(tags);
+}
 
-    free(runFiles);
-    free(currentOrders);
-    free(runFinished);
-    free(writeBuffer);
-    fflush(orderHistory);
-    fflush(orderIndex);
+// Ordena um buffer de registros pela chave long long em keyOffset (radix para buffers grandes)
+void sortRecordsByKey(void *buffer, long count, size_t size, size_t keyOffset)
+{
+    sortRecordsByKeyUsing(buffer, count, size, keyOffset, count >= RADIX_SORT_MIN);
+}
 
-    printf("Orders: %ld registros, %d indices\n", totalWritten, indexCount);
-    return totalWritten;
+
+// ------------------------------ Codificacao compacta dos registros ------------------------------
+// Datas viram segundos desde 1970, precos viram centavos e categoria, cor, metal e gema viram
+// codigos de um byte nos dicionarios salvos em ../data/dictionaries.dat.
+
+pthread_mutex_t dictionaryMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Dias desde 1970-01-01 no calendario gregoriano (days_from_civil)
+long long daysFromCivil(int year, int month, int day)
+{
+    year -= month <= 2;
+    long long era = (year >= 0 ? year : year - 399) / 400;
+    long long yearOfEra = year - era * 400;
+    long long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
 }
 
-int mergeJewelryRuns(int numRuns, FILE *jewelryRegister, FILE *jewelryIndex, int indexGap)
+// Dias desde 1970 para ano e mes (inverso de daysFromCivil)
+void civilFromDays(long long days, int *year, int *month)
+{
+    days += 719468;
+    long long era = (days >= 0 ? days : days - 146096) / 146097;
+    long long dayOfEra = days - era * 146097;
+    long long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    long long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    long long monthIndex = (5 * dayOfYear + 2) / 153;
+    *month = (int)(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+    *year = (int)(yearOfEra + era * 400 + (*month <= 2));
+}
+
+// "AAAA-MM-DD HH:MM:SS ..." em segundos desde 1970; -1 se a data nao for valida
+long long parseDateTime(const char *text)
+{
+    int year, month, day, hour = 0, minute = 0, second = 0;
+    if (sscanf(text, "%4d-%2d-%2d %2d:%2d:%2d", &year, &month, &day, &hour, &minute, &second) < 3)
+        return -1;
+    if (month < 1 || month > 12 || day < 1 || day > 31)
+        return -1;
+    return daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+// Segundos desde 1970 em "AAAA-MM-DD HH:MM:SS UTC" (vazio se a data for invalida)
+const char *formatDateTime(long long date, char *out)
+{
+    out[0] = '\0';
+    if (date < 0)
+        return out;
+
+    time_t seconds = (time_t)date;
+    struct tm *info = gmtime(&seconds);
+    if (info)
+        strftime(out, DATE_TEXT_SIZE, "%Y-%m-%d %H:%M:%S UTC", info);
+    return out;
+}
+
+float centsToUsd(int cents)
 {
-    FILE **runFiles = malloc(numRuns * sizeof(FILE *));
-    JEWELRY *currentJewelry = malloc(numRuns * sizeof(JEWELRY));
-    int *runFinished = calloc(numRuns, sizeof(int));
+    return cents / 100.0f;
+}
+
+// Codigo do texto [ptr, end) no dicionario do campo; um valor novo ganha o proximo codigo.
+// Os workers da carga chamam em paralelo.
+unsigned char dictionaryCode(int field, const char *ptr, const char *end)
+{
+    char value[DICTIONARY_VALUE];
+    size_t length = end - ptr;
+    if (length > sizeof(value) - 1)
+        length = sizeof(value) - 1;
+    memcpy(value, ptr, length);
+    value[length] = '\0';
+    if (length == 0)
+        return 0;
 
-    for (int i = 0; i < numRuns; i++)
+    pthread_mutex_lock(&dictionaryMutex);
+    int count = dictionaries.counts[field];
+    int code = 1;
+    while (code < count && strcmp(dictionaries.values[field][code], value) != 0)
+        code++;
+
+    if (code == count)
     {
-        char filename[50];
-        sprintf(filename, "../data/temp_jewelry_run_%d.dat", i);
-        runFiles[i] = fopen(filename, "rb");
-        if (fread(&currentJewelry[i], sizeof(JEWELRY), 1, runFiles[i]) != 1)
+        if (count < DICTIONARY_ENTRIES)
+        {
+            strcpy(dictionaries.values[field][code], value);
+            dictionaries.counts[field]++;
+            dictionaries.dirty = 1;
+        }
+        else
         {
-            runFinished[i] = 1;
+            printf("Dicionario cheio: '%s' gravado como vazio\n", value);
+            code = 0;
         }
     }
+    pthread_mutex_unlock(&dictionaryMutex);
+    return (unsigned char)code;
+}
 
-    const int WRITE_BUFFER_SIZE = 5000;
-    JEWELRY *writeBuffer = malloc(WRITE_BUFFER_SIZE * sizeof(JEWELRY));
-    int writeCount = 0;
-    long totalWritten = 0;
-    int indexCount = 0;
-    long long lastProductId = -1;
+// Codigos ainda nao usados apontam para entradas zeradas, entao o retorno e sempre valido
+const char *dictionaryValue(int field, unsigned char code)
+{
+    return dictionaries.values[field][code];
+}
 
-    while (1)
-    {
-        int minIndex = -1;
-        long long minProductId = LLONG_MAX;
+void resetDictionaries()
+{
+    memset(&dictionaries, 0, sizeof(DICTIONARIES));
+    for (int field = 0; field < DICTIONARY_FIELDS; field++)
+        dictionaries.counts[field] = 1;
+    dictionaries.dirty = 1;
+}
 
-        for (int i = 0; i < numRuns; i++)
-        {
-            if (!runFinished[i] && currentJewelry[i].product_id < minProductId)
-            {
-                minProductId = currentJewelry[i].product_id;
-                minIndex = i;
-            }
-        }
+void saveDictionaries()
+{
+    FILE *f = fopen("../data/dictionaries.dat", "wb");
+    if (!f)
+        return;
+    fwrite(dictionaries.counts, sizeof(int), DICTIONARY_FIELDS, f);
+    fwrite(dictionaries.values, sizeof(dictionaries.values), 1, f);
+    fclose(f);
+    dictionaries.dirty = 0;
+}
 
-        if (minIndex == -1)
-            break;
+int loadDictionaries()
+{
+    FILE *f = fopen("../data/dictionaries.dat", "rb");
+    if (!f)
+        return 0;
 
-        if (currentJewelry[minIndex].product_id != lastProductId)
-        {
-            writeBuffer[writeCount++] = currentJewelry[minIndex];
-            lastProductId = currentJewelry[minIndex].product_id;
+    int ok = fread(dictionaries.counts, sizeof(int), DICTIONARY_FIELDS, f) == DICTIONARY_FIELDS &&
+             fread(dictionaries.values, sizeof(dictionaries.values), 1, f) == 1;
+    fclose(f);
 
-            if (totalWritten % indexGap == 0)
-            {
-                INDEX indexEntry = {currentJewelry[minIndex].product_id, totalWritten * sizeof(JEWELRY)};
-                fwrite(&indexEntry, sizeof(INDEX), 1, jewelryIndex);
-                indexCount++;
-            }
+    for (int field = 0; ok && field < DICTIONARY_FIELDS; field++)
+        ok = dictionaries.counts[field] >= 1 && dictionaries.counts[field] <= DICTIONARY_ENTRIES;
+    if (!ok)
+        resetDictionaries();
+    dictionaries.dirty = 0;
+    return ok;
+}
 
-            totalWritten++;
+// -------------------------- Separar linhas do arquivo e salvar nos .dat referentes -----------------
+// O CSV e mapeado em memoria (mmap) e lido sem copias: os delimitadores sao localizados com
+// SIMD quando disponivel e os numeros sao convertidos direto dos bytes mapeados.
 
-            if (writeCount >= WRITE_BUFFER_SIZE)
-            {
-                fwrite(writeBuffer, sizeof(JEWELRY), writeCount, jewelryRegister);
-                writeCount = 0;
-            }
-        }
+int openCSVMap(FILE *csv, CSV_MAP *map)
+{
+    map->data = NULL;
+    map->size = 0;
+    map->mapped = 0;
 
-        if (fread(&currentJewelry[minIndex], sizeof(JEWELRY), 1, runFiles[minIndex]) != 1)
+#ifndef _WIN32
+    struct stat st;
+    if (fstat(fileno(csv), &st) == 0 && st.st_size > 0)
+    {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(csv), 0);
+        if (data != MAP_FAILED)
         {
-            runFinished[minIndex] = 1;
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            map->data = data;
+            map->size = st.st_size;
+            map->mapped = 1;
+            return 1;
         }
     }
+#endif
 
-    if (writeCount > 0)
-    {
-        fwrite(writeBuffer, sizeof(JEWELRY), writeCount, jewelryRegister);
-    }
+    // Sem mmap: carrega o arquivo inteiro em um buffer
+    fseek(csv, 0, SEEK_END);
+    long size = ftell(csv);
+    fseek(csv, 0, SEEK_SET);
+    if (size <= 0)
+        return 0;
+
+    char *data = malloc(size);
+    if (!data)
+        return 0;
+    map->size = fread(data, 1, size, csv);
+    map->data = data;
+    return 1;
+}
 
-    for (int i = 0; i < numRuns; i++)
+void closeCSVMap(CSV_MAP *map)
+{
+#ifndef _WIN32
+    if (map->mapped)
     {
-        fclose(runFiles[i]);
-        char filename[50];
-        sprintf(filename, "../data/temp_jewelry_run_%d.dat", i);
-        remove(filename);
+        munmap((void *)map->data, map->size);
+        return;
     }
-
-    free(runFiles);
-    free(currentJewelry);
-    free(runFinished);
-    free(writeBuffer);
-    fflush(jewelryRegister);
-    fflush(jewelryIndex);
-
-    printf("Jewelry: %ld registros unicos, %d indices\n\n", totalWritten, indexCount);
-    return totalWritten;
+#endif
+    free((void *)map->data);
 }
 
-int processCategoryData(FILE *jewelryRegister, FILE *categoryRegister,
-                        FILE *categoryIndex, int indexGap)
+// Retorna o primeiro ',' ou '\n' em [ptr, end), ou end
+const char *findDelimiter(const char *ptr, const char *end)
 {
-    FILE *tempCat = fopen("../data/temp_category_run_0.dat", "rb");
-    if (!tempCat)
+#if defined(__AVX2__)
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    while (ptr + 32 <= end)
     {
-        printf("Erro ao abrir arquivo temporario de categorias\n");
-        return 0;
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)ptr);
+        unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, comma),
+                                                             _mm256_cmpeq_epi8(bytes, newline)));
+        if (mask)
+            return ptr + __builtin_ctz(mask);
+        ptr += 32;
     }
+#elif defined(__SSE2__)
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (ptr + 16 <= end)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)ptr);
+        unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, comma),
+                                                       _mm_cmpeq_epi8(bytes, newline)));
+        if (mask)
+            return ptr + __builtin_ctz(mask);
+        ptr += 16;
+    }
+#endif
+    while (ptr < end && *ptr != ',' && *ptr != '\n')
+        ptr++;
+    return ptr;
+}
 
-    fseek(tempCat, 0, SEEK_END);
-    long catCount = ftell(tempCat) / sizeof(CATEGORY);
-    fseek(tempCat, 0, SEEK_SET);
+long long parseInt64(const char *ptr, const char *end)
+{
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t'))
+        ptr++;
 
-    CATEGORY *categories = malloc(catCount * sizeof(CATEGORY));
-    fread(categories, sizeof(CATEGORY), catCount, tempCat);
-    fclose(tempCat);
-    remove("../data/temp_category_run_0.dat");
+    int negative = 0;
+    if (ptr < end && (*ptr == '-' || *ptr == '+'))
+        negative = (*ptr++ == '-');
 
-    fseek(jewelryRegister, 0, SEEK_END);
-    long jewelryCount = ftell(jewelryRegister) / sizeof(JEWELRY);
-    fseek(jewelryRegister, 0, SEEK_SET);
+    unsigned long long value = 0;
+    while (ptr < end && *ptr >= '0' && *ptr <= '9')
+        value = value * 10 + (*ptr++ - '0');
 
-    JEWELRY jewelry;
-    for (long i = 0; i < jewelryCount; i++)
-    {
-        if (fread(&jewelry, sizeof(JEWELRY), 1, jewelryRegister) != 1)
-            break;
+    return negative ? -(long long)value : (long long)value;
+}
 
-        for (int j = 0; j < catCount; j++)
-        {
-            if (categories[j].category_id == jewelry.category_id)
-            {
-                categories[j].product_count++;
-                break;
-            }
-        }
+double parseDecimal(const char *ptr, const char *end)
+{
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t'))
+        ptr++;
 
-        if ((i + 1) % 1000 == 0)
-        {
-            fflush(stdout);
-        }
-    }
+    int negative = 0;
+    if (ptr < end && (*ptr == '-' || *ptr == '+'))
+        negative = (*ptr++ == '-');
 
-    printf("\n");
+    unsigned long long mantissa = 0;
+    double scale = 1.0;
+    while (ptr < end && *ptr >= '0' && *ptr <= '9')
+        mantissa = mantissa * 10 + (*ptr++ - '0');
 
-    for (int i = 0; i < catCount; i++)
+    if (ptr < end && *ptr == '.')
     {
-        long pos = i * sizeof(CATEGORY);
-        fwrite(&categories[i], sizeof(CATEGORY), 1, categoryRegister);
-
-        if (i % indexGap == 0)
+        ptr++;
+        while (ptr < end && *ptr >= '0' && *ptr <= '9' && scale < 1e18)
         {
-            INDEX indexEntry = {categories[i].category_id, pos};
-            fwrite(&indexEntry, sizeof(INDEX), 1, categoryIndex);
+            mantissa = mantissa * 10 + (*ptr++ - '0');
+            scale *= 10.0;
         }
     }
 
-    fflush(categoryRegister);
-    fflush(categoryIndex);
-
-    printf("Categories: %ld registros\n\n", catCount);
-
-    free(categories);
-    return catCount;
+    double value = mantissa / scale;
+    return negative ? -value : value;
 }
 
-void readCSVExternalSort(FILE *csv, FILE *orderHistory, FILE *orderIndex,
-                         FILE *jewelryRegister, FILE *jewelryIndex,
-                         FILE *categoryRegister, FILE *categoryIndex, int indexGap)
+// "455.89" em 45589 (arredonda a partir da terceira casa)
+int parseCents(const char *ptr, const char *end)
 {
-    printf("Limite memoria: %d registros\n", MEMORY_LIMIT);
-    printf("Limite indice: %d\n\n", indexGap);
-
-    int numOrderRuns, numJewelryRuns, numCategoryRuns;
-    createSortedRuns(csv, &numOrderRuns, &numJewelryRuns, &numCategoryRuns);
-    mergeOrderRuns(numOrderRuns, orderHistory, orderIndex, indexGap);
-    mergeJewelryRuns(numJewelryRuns, jewelryRegister, jewelryIndex, indexGap);
-    processCategoryData(jewelryRegister, categoryRegister, categoryIndex, indexGap);
+    double cents = parseDecimal(ptr, end) * 100.0;
+    return (int)(cents < 0 ? cents - 0.5 : cents + 0.5);
 }
 
-CATEGORY *searchCategoryById(FILE *categoryRegister, FILE *categoryIndex,
-                             long long int category_id, int indexGap)
+void copyField(char *dest, size_t destSize, const char *ptr, const char *end)
 {
+    size_t length = end - ptr;
+    if (length > destSize - 1)
+        length = destSize - 1;
+    memcpy(dest, ptr, length);
+    dest[length] = '\0';
+}
 
-    fseek(categoryIndex, 0, SEEK_END);
-    long fileSize = ftell(categoryIndex);
-    int totalEntries = fileSize / sizeof(INDEX);
-
-    if (totalEntries == 0)
-        return NULL;
-
-    int left = 0, right = totalEntries - 1;
-    long startPosition = 0;
-    INDEX currentIndex;
+// Converte uma linha do CSV em ORDER; retorna o inicio da proxima linha.
+// *fields recebe a quantidade de campos lidos (0 para linha vazia).
+const char *parseCSVRecord(const char *ptr, const char *end, ORDER *order, int *fields)
+{
+    int field = 0;
+    order->status = ACTIVE_FLAG;
 
-    while (left <= right)
+    // Linha vazia ("\n" ou "\r\n") nao gera registro
+    if (ptr < end && *ptr == '\r')
+        ptr++;
+    if (ptr < end && *ptr == '\n')
     {
-        int middle = left + (right - left) / 2;
-        fseek(categoryIndex, middle * sizeof(INDEX), SEEK_SET);
-        fread(&currentIndex, sizeof(INDEX), 1, categoryIndex);
+        *fields = 0;
+        return ptr + 1;
+    }
 
-        if (currentIndex.id == category_id)
-        {
-            startPosition = currentIndex.position;
-            break;
-        }
+    while (ptr < end)
+    {
+        const char *delimiter = findDelimiter(ptr, end);
+        const char *fieldEnd = delimiter;
+        if (fieldEnd > ptr && fieldEnd[-1] == '\r')
+            fieldEnd--;
 
-        if (currentIndex.id < category_id)
+        switch (field)
         {
-            startPosition = currentIndex.position;
-            left = middle + 1;
-        }
-        else
+        case 0:
         {
-            right = middle - 1;
+            char date[DATE_TEXT_SIZE];
+            copyField(date, sizeof(date), ptr, fieldEnd);
+            order->date = parseDateTime(date);
+            break;
         }
-    }
-
-    CATEGORY *category = malloc(sizeof(CATEGORY));
-    if (!category)
-        return NULL;
-
-    fseek(categoryRegister, startPosition, SEEK_SET);
+        case 1:
+            order->order_id = parseInt64(ptr, fieldEnd);
+            break;
+        case 2:
+            order->product_id = parseInt64(ptr, fieldEnd);
+            break;
+        case 3:
+            order->quantity = (int)parseInt64(ptr, fieldEnd);
+            break;
+        case 4:
+            order->category_id = parseInt64(ptr, fieldEnd);
+            break;
+        case 5:
+            order->category_alias = dictionaryCode(DICT_CATEGORY, ptr, fieldEnd);
+            break;
+        case 6:
+            order->brand_id = (short)parseInt64(ptr, fieldEnd);
+            break;
+        case 7:
+            order->price_cents = parseCents(ptr, fieldEnd);
+            break;
+        case 8:
+            order->user_id = parseInt64(ptr, fieldEnd);
+            break;
+        case 9:
+            order->product_gender = (fieldEnd > ptr) ? *ptr : '\0';
+            break;
+        case 10:
+            order->color = dictionaryCode(DICT_COLOR, ptr, fieldEnd);
+            break;
+        case 11:
+            order->metal = dictionaryCode(DICT_METAL, ptr, fieldEnd);
+            break;
+        case 12:
+            order->gem = dictionaryCode(DICT_GEM, ptr, fieldEnd);
+            break;
+        }
+        field++;
 
-    for (int i = 0; i < indexGap; i++)
-    {
-        if (fread(category, sizeof(CATEGORY), 1, categoryRegister) != 1)
+        if (delimiter >= end)
+        {
+            ptr = end;
             break;
+        }
 
-        if (category->category_id == category_id)
-            return category;
-        if (category->category_id > category_id)
+        ptr = delimiter + 1;
+        if (*delimiter == '\n')
             break;
     }
 
-    free(category);
-    return NULL;
+    *fields = field;
+    return ptr;
 }
 
-int updateCategorySales(FILE *categoryRegister, FILE *categoryIndex,
-                        long long int category_id, int quantity, float revenue, int indexGap)
+// ------------------------------ Geracao dos runs ordenados ------------------------------
+// Cada worker faz o parsing de blocos de linhas do CSV, acumula ordens e joias em buffers
+// de MEMORY_LIMIT registros e grava um run ordenado sempre que o buffer enche. A numeracao
+// dos runs e compartilhada entre os workers, entao o merge continua enxergando
+// temp_order_run_0..N-1 e temp_jewelry_run_0..M-1 como na carga sequencial.
+
+pthread_mutex_t runMutex = PTHREAD_MUTEX_INITIALIZER;
+int runWriteFailed = 0; // Algum run nao pode ser criado: a carga e abortada
+
+// Os runs sao distribuidos em rodizio pelos diretorios de spill (config.spillDirs)
+void runFileName(char *filename, const char *prefix, int run)
 {
-    CATEGORY *cat = searchCategoryById(categoryRegister, categoryIndex, category_id, indexGap);
+    const char *dir = config.spillDirs[run % config.numSpillDirs];
+    snprintf(filename, RUN_PATH_MAX, "%s/temp_%s_run_%d.dat", dir, prefix, run);
+}
 
-    if (!cat)
+// Apaga os runs 0..count-1 de prefix (carga abortada antes do merge)
+void removeRuns(const char *prefix, int count)
+{
+    for (int i = 0; i < count; i++)
     {
-        printf("Categoria %lld nao encontrada\n", category_id);
-        return 0;
+        char filename[RUN_PATH_MAX];
+        runFileName(filename, prefix, i);
+        remove(filename);
     }
+}
 
-    cat->total_sales += quantity;
-    cat->total_revenue += revenue;
+// Saida do merge intermediario do grupo g: mesmo diretorio do run g, para o rename funcionar
+void mergeFileName(char *filename, const char *prefix, int group)
+{
+    const char *dir = config.spillDirs[group % config.numSpillDirs];
+    snprintf(filename, RUN_PATH_MAX, "%s/temp_%s_merge_%d.dat", dir, prefix, group);
+}
 
-    // Encontra posição no arquivo e atualiza
-    fseek(categoryRegister, 0, SEEK_SET);
-    CATEGORY temp;
-    long pos = 0;
+// Abre o proximo run do builder (numero global) com buffer de escrita grande
+// (runFile fica NULL se o arquivo nao puder ser criado)
+void startRun(RUN_BUILDER *builder)
+{
+    builder->runFile = NULL;
+    builder->runLength = 0;
+
+    pthread_mutex_lock(&runMutex);
+    int failed = runWriteFailed;
+    if (!failed)
+        builder->runNumber = (*builder->runCounter)++;
+    pthread_mutex_unlock(&runMutex);
+    if (failed)
+        return;
 
-    while (fread(&temp, sizeof(CATEGORY), 1, categoryRegister) == 1)
+    char filename[RUN_PATH_MAX];
+    runFileName(filename, builder->prefix, builder->runNumber);
+    builder->runFile = fopen(filename, "wb");
+    if (!builder->runFile)
     {
-        if (temp.category_id == category_id)
-        {
-            fseek(categoryRegister, pos, SEEK_SET);
-            fwrite(cat, sizeof(CATEGORY), 1, categoryRegister);
-            fflush(categoryRegister);
-            free(cat);
-            return 1;
-        }
-        pos += sizeof(CATEGORY);
+        pthread_mutex_lock(&runMutex);
+        if (!runWriteFailed)
+            printf("Erro ao criar o run %s.\n", filename);
+        runWriteFailed = 1;
+        pthread_mutex_unlock(&runMutex);
+        return;
     }
+    setvbuf(builder->runFile, NULL, _IOFBF, RUN_READ_BUFFER);
+}
 
-    free(cat);
-    return 0;
+void finishRun(RUN_BUILDER *builder)
+{
+    fclose(builder->runFile);
+    builder->runFile = NULL;
+    builder->runsCreated++;
+    builder->recordsSpilled += builder->runLength;
+
+    printf("  Run %d de %s criado (%ld registros)\n", builder->runNumber, builder->prefix, builder->runLength);
 }
 
+// Estrategia RUN_STRATEGY_SORT: ordena o buffer cheio e grava como um run
+void writeSortedRun(RUN_BUILDER *builder, char *buffer, long count)
+{
+    sortRecordsByKey(buffer, count, builder->recordSize, builder->keyOffset);
 
-// RESPONDE: Qual a categoria com mais itens vendidos?-------------------------------------------------
-void findBestSellingCategory(FILE *categoryRegister)
+    startRun(builder);
+    if (!builder->runFile)
+        return;
+    fwrite(buffer, builder->recordSize, count, builder->runFile);
+    builder->runLength = count;
+    finishRun(builder);
+}
+
+void *spillWriterThread(void *arg)
 {
-    fseek(categoryRegister, 0, SEEK_END);
-    long totalCategories = ftell(categoryRegister) / sizeof(CATEGORY);
+    RUN_BUILDER *builder = (RUN_BUILDER *)arg;
+    writeSortedRun(builder, builder->pendingBuffer, builder->pendingCount);
+    return NULL;
+}
 
-    if (totalCategories == 0)
+void waitSpillWriter(RUN_BUILDER *builder)
+{
+    if (builder->writerActive)
     {
-        printf("Nenhuma categoria encontrada.\n");
+        pthread_join(builder->writer, NULL);
+        builder->writerActive = 0;
+    }
+}
+
+// Com config.asyncSpill o buffer cheio vai para uma thread de escrita e o parsing continua
+// no buffer reserva; so espera se a escrita anterior ainda nao terminou.
+void spillRun(RUN_BUILDER *builder)
+{
+    if (builder->count == 0)
+        return;
+
+    if (!config.asyncSpill)
+    {
+        writeSortedRun(builder, builder->buffer, builder->count);
+        builder->count = 0;
         return;
     }
 
-    printf("Analisando %ld categorias...\n\n", totalCategories);
+    waitSpillWriter(builder);
 
-    // Carrega todas as categorias
-    CATEGORY *categories = malloc(totalCategories * sizeof(CATEGORY));
-    fseek(categoryRegister, 0, SEEK_SET);
-    fread(categories, sizeof(CATEGORY), totalCategories, categoryRegister);
+    builder->pendingBuffer = builder->buffer;
+    builder->pendingCount = builder->count;
+    builder->buffer = builder->spareBuffer;
+    builder->spareBuffer = builder->pendingBuffer;
+    builder->count = 0;
 
-    // Ordena por total_sales
-    quicksort(categories, totalCategories, sizeof(CATEGORY), compareCategorySales);
+    builder->writerActive = (pthread_create(&builder->writer, NULL, spillWriterThread, builder) == 0);
+    if (!builder->writerActive)
+        writeSortedRun(builder, builder->pendingBuffer, builder->pendingCount);
+}
 
-    // Exibe TOP 10
-    printf("=== TOP 10 CATEGORIAS ===\n");
-    printf("%-4s %-15s %-30s %-12s %-15s %-12s\n",
-           "Pos", "Category ID", "Alias", "Produtos", "Vendas", "Receita");
-    printf("------------------------------------------------------------------------------------\n");
+// Estrategia RUN_STRATEGY_REPLACEMENT: heap (run, chave) sobre os registros do buffer.
+// Um registro com chave menor que a ultima gravada fica marcado para o proximo run.
+int rsLess(RS_ENTRY *a, RS_ENTRY *b)
+{
+    if (a->run != b->run)
+        return a->run < b->run;
+    return a->key < b->key;
+}
 
-    int limit = (totalCategories < 10) ? totalCategories : 10;
-    for (int i = 0; i < limit; i++)
+void rsSiftUp(RS_ENTRY *heap, long i)
+{
+    while (i > 0)
     {
-        printf("%-4d %-15lld %-30s %-12d %-15d $%-11.2f\n",
-               i + 1,
-               categories[i].category_id,
-               categories[i].category_alias,
-               categories[i].product_count,
-               categories[i].total_sales,
-               categories[i].total_revenue);
+        long parent = (i - 1) / 2;
+        if (!rsLess(&heap[i], &heap[parent]))
+            break;
+        RS_ENTRY temp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = temp;
+        i = parent;
     }
-    printf("------------------------------------------------------------------------------------\n\n");
-    free(categories);
 }
 
-int isOrderRemoved(ORDER *order)
+void rsSiftDown(RS_ENTRY *heap, long count, long i)
 {
-    return (order->data[0] == REMOVED_FLAG);
+    while (1)
+    {
+        long smallest = i;
+        long left = 2 * i + 1;
+        long right = left + 1;
+
+        if (left < count && rsLess(&heap[left], &heap[smallest]))
+            smallest = left;
+        if (right < count && rsLess(&heap[right], &heap[smallest]))
+            smallest = right;
+        if (smallest == i)
+            break;
+
+        RS_ENTRY temp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = temp;
+        i = smallest;
+    }
 }
 
-ORDER *searchOrderById(FILE *orderHistory, FILE *orderIndex, FILE *orderOverflow,
-                       long long int target_id, int indexGap)
+// Grava o menor registro do heap no run atual e retorna o slot liberado
+int rsEmitTop(RUN_BUILDER *builder)
 {
+    RS_ENTRY *top = &builder->heap[0];
 
-    fseek(orderIndex, 0, SEEK_END);
-    long fileSize = ftell(orderIndex);
-    int totalEntries = fileSize / sizeof(INDEX);
-
-    if (totalEntries == 0)
-        return NULL;
+    if (builder->runFile && top->run != builder->currentRun)
+        finishRun(builder);
+    if (!builder->runFile)
+    {
+        builder->currentRun = top->run;
+        startRun(builder);
+        if (!builder->runFile)
+            return top->slot;
+    }
 
-    int left = 0, right = totalEntries - 1;
-    long startPosition = 0;
-    INDEX currentIndex;
+    fwrite(builder->buffer + top->slot * builder->recordSize, builder->recordSize, 1, builder->runFile);
+    builder->runLength++;
+    builder->lastKey = top->key;
+    return top->slot;
+}
 
-    while (left <= right)
+void runBuilderAdd(RUN_BUILDER *builder, const void *record)
+{
+    if (config.runStrategy == RUN_STRATEGY_SORT)
     {
-        int middle = left + (right - left) / 2;
-        fseek(orderIndex, middle * sizeof(INDEX), SEEK_SET);
-        fread(&currentIndex, sizeof(INDEX), 1, orderIndex);
+        memcpy(builder->buffer + builder->count * builder->recordSize, record, builder->recordSize);
+        if (++builder->count >= MEMORY_LIMIT)
+            spillRun(builder);
+        return;
+    }
 
-        if (currentIndex.id == target_id)
-        {
-            startPosition = currentIndex.position;
-            break;
-        }
+    long long key = recordKey(record, builder->keyOffset);
 
-        if (currentIndex.id < target_id)
-        {
-            startPosition = currentIndex.position;
-            left = middle + 1;
-        }
-        else
-        {
-            right = middle - 1;
-        }
+    if (builder->count < MEMORY_LIMIT)
+    {
+        int slot = builder->count++;
+        memcpy(builder->buffer + slot * builder->recordSize, record, builder->recordSize);
+        builder->heap[slot].run = builder->currentRun;
+        builder->heap[slot].key = key;
+        builder->heap[slot].slot = slot;
+        rsSiftUp(builder->heap, slot);
+        return;
     }
 
-    ORDER *order = malloc(sizeof(ORDER));
-    if (!order)
-        return NULL;
+    int slot = rsEmitTop(builder);
+    memcpy(builder->buffer + slot * builder->recordSize, record, builder->recordSize);
+    builder->heap[0].run = (key >= builder->lastKey) ? builder->currentRun : builder->currentRun + 1;
+    builder->heap[0].key = key;
+    builder->heap[0].slot = slot;
+    rsSiftDown(builder->heap, builder->count, 0);
+}
 
-    fseek(orderHistory, startPosition, SEEK_SET);
+// Grava o que restou no buffer/heap e fecha o run aberto
+void runBuilderFinish(RUN_BUILDER *builder)
+{
+    if (config.runStrategy == RUN_STRATEGY_SORT)
+    {
+        spillRun(builder);
+        waitSpillWriter(builder);
+        return;
+    }
 
-    for (int i = 0; i < indexGap; i++)
+    while (builder->count > 0)
     {
-        if (fread(order, sizeof(ORDER), 1, orderHistory) != 1)
-            break;
+        rsEmitTop(builder);
+        builder->heap[0] = builder->heap[--builder->count];
+        rsSiftDown(builder->heap, builder->count, 0);
+    }
+
+    if (builder->runFile)
+        finishRun(builder);
+}
+
+void initRunBuilder(RUN_BUILDER *builder, const char *prefix, size_t recordSize, size_t keyOffset,
+                    int *runCounter)
+{
+    builder->prefix = prefix;
+    builder->recordSize = recordSize;
+    builder->keyOffset = keyOffset;
+    builder->buffer = malloc(MEMORY_LIMIT * recordSize);
+    builder->spareBuffer = (config.runStrategy == RUN_STRATEGY_SORT && config.asyncSpill) ? malloc(MEMORY_LIMIT * recordSize) : NULL;
+    builder->pendingBuffer = NULL;
+    builder->pendingCount = 0;
+    builder->writerActive = 0;
+    builder->count = 0;
+    builder->runCounter = runCounter;
+    builder->heap = (config.runStrategy == RUN_STRATEGY_REPLACEMENT) ? malloc(MEMORY_LIMIT * sizeof(RS_ENTRY)) : NULL;
+    builder->currentRun = 0;
+    builder->lastKey = LLONG_MIN;
+    builder->runFile = NULL;
+    builder->runNumber = 0;
+    builder->runLength = 0;
+    builder->runsCreated = 0;
+    builder->recordsSpilled = 0;
+}
+
+void freeRunBuilder(RUN_BUILDER *builder)
+{
+    free(builder->buffer);
+    free(builder->spareBuffer);
+    free(builder->heap);
+}
+
+void addCategorySale(CategoryNode **categoryHash, ORDER *order)
+{
+    int hashIdx = order->category_id % 1000;
+    CategoryNode *current = categoryHash[hashIdx];
 
-        if (order->order_id == target_id && !isOrderRemoved(order))
+    while (current)
+    {
+        if (current->data.category_id == order->category_id)
         {
-            return order;
+            current->data.total_sales += order->quantity;
+            current->data.total_revenue += (centsToUsd(order->price_cents) * order->quantity);
+            return;
         }
-        if (order->order_id > target_id)
-            break;
+        current = current->next;
     }
 
-    if (orderOverflow)
-    {
-        fseek(orderOverflow, 0, SEEK_SET);
-        OVERFLOW_RECORD overflow;
+    CategoryNode *newNode = malloc(sizeof(CategoryNode));
+    newNode->data.category_id = order->category_id;
+    strncpy(newNode->data.category_alias, dictionaryValue(DICT_CATEGORY, order->category_alias),
+            sizeof(newNode->data.category_alias) - 1);
+    newNode->data.category_alias[sizeof(newNode->data.category_alias) - 1] = '\0';
+    newNode->data.product_count = 0;
+    newNode->data.total_sales = order->quantity;
+    newNode->data.total_revenue = (centsToUsd(order->price_cents) * order->quantity);
+    newNode->next = categoryHash[hashIdx];
+    categoryHash[hashIdx] = newNode;
+}
 
-        while (fread(&overflow, sizeof(OVERFLOW_RECORD), 1, orderOverflow) == 1)
+// Junta a agregacao de categorias de um worker na tabela principal (libera "from")
+void mergeCategoryHash(CategoryNode **into, CategoryNode **from)
+{
+    for (int i = 0; i < 1000; i++)
+    {
+        CategoryNode *current = from[i];
+        while (current)
         {
-            if (overflow.record.order_id == target_id && !isOrderRemoved(&overflow.record))
+            CategoryNode *next = current->next;
+            CategoryNode *found = into[i];
+
+            while (found && found->data.category_id != current->data.category_id)
+                found = found->next;
+
+            if (found)
             {
-                *order = overflow.record;
-                return order;
+                found->data.total_sales += current->data.total_sales;
+                found->data.total_revenue += current->data.total_revenue;
+                free(current);
+            }
+            else
+            {
+                current->next = into[i];
+                into[i] = current;
             }
+            current = next;
         }
     }
-
-    free(order);
-    return NULL;
+    free(from);
 }
 
-void getCurrentDateTimeUTC(char *buffer)
+void initIngestWorker(INGEST_WORKER *worker, int *orderRunNum, int *jewelryRunNum)
 {
-    time_t rawtime;
-    struct tm *info;
+    initRunBuilder(&worker->orders, "order", sizeof(ORDER), offsetof(ORDER, order_id), orderRunNum);
+    initRunBuilder(&worker->jewelry, "jewelry", sizeof(JEWELRY), offsetof(JEWELRY, product_id), jewelryRunNum);
+
+    worker->categoryHash = calloc(1000, sizeof(CategoryNode *));
+    worker->queue = NULL;
+}
 
-    time(&rawtime);
+void ingestOrder(INGEST_WORKER *worker, ORDER *order)
+{
+    runBuilderAdd(&worker->orders, order);
 
-    info = gmtime(&rawtime);
+    JEWELRY jewelry = {0};
+    jewelry.product_id = order->product_id;
+    jewelry.category_id = order->category_id;
+    jewelry.brand_id = order->brand_id;
+    jewelry.price_cents = order->price_cents;
+    jewelry.product_gender = order->product_gender;
+    jewelry.color = order->color;
+    jewelry.metal = order->metal;
+    jewelry.gem = order->gem;
 
-    strftime(buffer, 30, "%Y-%m-%d %H:%M:%S", info);
+    runBuilderAdd(&worker->jewelry, &jewelry);
 
-    strcat(buffer, " UTC");
+    addCategorySale(worker->categoryHash, order);
 }
 
-int insertOrderWithOverflow(ORDER *newOrder, FILE *orderHistory, FILE *orderIndex,
-                            FILE *orderOverflow, FILE *categoryRegister,
-                            FILE *categoryIndex, int indexGap)
+// Processa um bloco de linhas completas (terminado em '\n' ou no fim do arquivo)
+void ingestChunk(INGEST_WORKER *worker, const char *data, size_t length)
 {
+    const char *ptr = data;
+    const char *end = data + length;
 
-    fseek(orderHistory, 0, SEEK_END);
-    long fileSize = ftell(orderHistory);
-    long totalRecords = fileSize / sizeof(ORDER);
-
-    if (totalRecords == 0)
+    while (ptr < end)
     {
-        fwrite(newOrder, sizeof(ORDER), 1, orderHistory);
-        fflush(orderHistory);
-
-        INDEX indexEntry = {newOrder->order_id, 0};
-        fwrite(&indexEntry, sizeof(INDEX), 1, orderIndex);
-        fflush(orderIndex);
+        ORDER order = {0};
+        int fields;
+        ptr = parseCSVRecord(ptr, end, &order, &fields);
+        if (fields == 0)
+            continue;
 
-        // Atualiza categoria
-        updateCategorySales(categoryRegister, categoryIndex, newOrder->category_id,
-                            newOrder->quantity, newOrder->price_usd * newOrder->quantity, indexGap);
-        return 1;
+        ingestOrder(worker, &order);
     }
+}
 
-    fseek(orderIndex, 0, SEEK_END);
-    int totalIndices = ftell(orderIndex) / sizeof(INDEX);
+void initChunkQueue(CHUNK_QUEUE *queue, int capacity)
+{
+    queue->chunks = malloc(capacity * sizeof(CSV_CHUNK));
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->count = 0;
+    queue->closed = 0;
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->notEmpty, NULL);
+    pthread_cond_init(&queue->notFull, NULL);
+}
 
-    int left = 0, right = totalIndices - 1;
-    long blockStart = 0;
-    INDEX idx;
+void destroyChunkQueue(CHUNK_QUEUE *queue)
+{
+    pthread_mutex_destroy(&queue->mutex);
+    pthread_cond_destroy(&queue->notEmpty);
+    pthread_cond_destroy(&queue->notFull);
+    free(queue->chunks);
+}
 
-    while (left <= right)
-    {
-        int mid = left + (right - left) / 2;
-        fseek(orderIndex, mid * sizeof(INDEX), SEEK_SET);
-        fread(&idx, sizeof(INDEX), 1, orderIndex);
+void pushChunk(CHUNK_QUEUE *queue, CSV_CHUNK chunk)
+{
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count == queue->capacity)
+        pthread_cond_wait(&queue->notFull, &queue->mutex);
 
-        if (idx.id <= newOrder->order_id)
-        {
-            blockStart = idx.position;
-            left = mid + 1;
-        }
-        else
-        {
-            right = mid - 1;
-        }
-    }
+    queue->chunks[(queue->head + queue->count) % queue->capacity] = chunk;
+    queue->count++;
+
+    pthread_cond_signal(&queue->notEmpty);
+    pthread_mutex_unlock(&queue->mutex);
+}
 
-    ORDER testOrder;
-    fseek(orderHistory, blockStart, SEEK_SET);
-    int blockRecords = 0;
+// Retorna 0 quando a fila foi fechada e nao ha mais blocos
+int popChunk(CHUNK_QUEUE *queue, CSV_CHUNK *chunk)
+{
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count == 0 && !queue->closed)
+        pthread_cond_wait(&queue->notEmpty, &queue->mutex);
 
-    for (int i = 0; i < BLOCK_SIZE && blockStart + i * sizeof(ORDER) < fileSize; i++)
+    if (queue->count == 0)
     {
-        if (fread(&testOrder, sizeof(ORDER), 1, orderHistory) != 1)
-            break;
-        blockRecords++;
+        pthread_mutex_unlock(&queue->mutex);
+        return 0;
     }
 
-    if (blockRecords >= BLOCK_SIZE)
-    {
-        printf("\n**Bloco cheio, usando overflow...\n");
+    *chunk = queue->chunks[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
 
-        OVERFLOW_RECORD overflow;
-        overflow.record = *newOrder;
-        overflow.originalBlockPos = blockStart;
-        overflow.nextOverflow = -1;
+    pthread_cond_signal(&queue->notFull);
+    pthread_mutex_unlock(&queue->mutex);
+    return 1;
+}
 
-        fseek(orderOverflow, 0, SEEK_END);
-        fwrite(&overflow, sizeof(OVERFLOW_RECORD), 1, orderOverflow);
-        fflush(orderOverflow);
+void closeChunkQueue(CHUNK_QUEUE *queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    queue->closed = 1;
+    pthread_cond_broadcast(&queue->notEmpty);
+    pthread_mutex_unlock(&queue->mutex);
+}
 
-        printf("**Registro inserido em overflow\n");
-    }
-    else
+void *ingestWorkerThread(void *arg)
+{
+    INGEST_WORKER *worker = (INGEST_WORKER *)arg;
+    CSV_CHUNK chunk;
+
+    while (popChunk(worker->queue, &chunk))
+        ingestChunk(worker, chunk.data, chunk.length);
+
+    runBuilderFinish(&worker->orders);
+    runBuilderFinish(&worker->jewelry);
+    return NULL;
+}
+
+// Proximo bloco do CSV mapeado com ~CSV_CHUNK_SIZE bytes, estendido ate o fim da linha
+int nextCSVChunk(CSV_MAP *map, size_t *offset, CSV_CHUNK *chunk)
+{
+    if (*offset >= map->size)
+        return 0;
+
+    const char *start = map->data + *offset;
+    const char *end = map->data + map->size;
+    const char *chunkEnd = end;
+
+    if ((size_t)(end - start) > CSV_CHUNK_SIZE)
     {
-        fseek(orderHistory, 0, SEEK_END);
-        fwrite(newOrder, sizeof(ORDER), 1, orderHistory);
-        fflush(orderHistory);
-        printf("\n**Registro inserido no final\n");
+        const char *newline = memchr(start + CSV_CHUNK_SIZE, '\n', end - (start + CSV_CHUNK_SIZE));
+        chunkEnd = newline ? newline + 1 : end;
     }
 
-    // Atualiza categoria
-    updateCategorySales(categoryRegister, categoryIndex, newOrder->category_id,
-                        newOrder->quantity, newOrder->price_usd * newOrder->quantity, indexGap);
-
+    chunk->data = start;
+    chunk->length = chunkEnd - start;
+    *offset += chunk->length;
     return 1;
 }
 
-JEWELRY *searchJewelryById(FILE *jewelryRegister, FILE *jewelryIndex,
-                           long long int product_id, int indexGap)
+// Retorna -1 se algum run nao pode ser gravado (carga abortada)
+int createSortedRuns(FILE *csv, int *numOrderRuns, int *numJewelryRuns, int *numCategoryRuns)
 {
+    runWriteFailed = 0;
+    int orderRunNum = 0;
+    int jewelryRunNum = 0;
+    int numWorkers = (config.ingestThreads > 1) ? config.ingestThreads : 1;
 
-    fseek(jewelryIndex, 0, SEEK_END);
-    long fileSize = ftell(jewelryIndex);
-    int totalEntries = fileSize / sizeof(INDEX);
+    INGEST_WORKER *workers = malloc(numWorkers * sizeof(INGEST_WORKER));
+    for (int i = 0; i < numWorkers; i++)
+        initIngestWorker(&workers[i], &orderRunNum, &jewelryRunNum);
 
-    if (totalEntries == 0)
-        return NULL;
+    CSV_MAP map;
+    size_t offset = 0;
+    CSV_CHUNK chunk;
 
-    int left = 0, right = totalEntries - 1;
-    long startPosition = 0;
-    INDEX currentIndex;
+    if (!openCSVMap(csv, &map))
+        map.size = 0;
 
-    while (left <= right)
+    if (numWorkers == 1)
     {
-        int middle = left + (right - left) / 2;
-        fseek(jewelryIndex, middle * sizeof(INDEX), SEEK_SET);
-        fread(&currentIndex, sizeof(INDEX), 1, jewelryIndex);
+        while (nextCSVChunk(&map, &offset, &chunk))
+            ingestChunk(&workers[0], chunk.data, chunk.length);
+        runBuilderFinish(&workers[0].orders);
+        runBuilderFinish(&workers[0].jewelry);
+    }
+    else
+    {
+        CHUNK_QUEUE queue;
+        initChunkQueue(&queue, numWorkers * 2);
+        pthread_t *threads = malloc(numWorkers * sizeof(pthread_t));
 
-        if (currentIndex.id == product_id)
+        for (int i = 0; i < numWorkers; i++)
         {
-            startPosition = currentIndex.position;
-            break;
+            workers[i].queue = &queue;
+            pthread_create(&threads[i], NULL, ingestWorkerThread, &workers[i]);
         }
 
-        if (currentIndex.id < product_id)
+        while (nextCSVChunk(&map, &offset, &chunk))
+            pushChunk(&queue, chunk);
+        closeChunkQueue(&queue);
+
+        for (int i = 0; i < numWorkers; i++)
+            pthread_join(threads[i], NULL);
+
+        destroyChunkQueue(&queue);
+        free(threads);
+    }
+    if (map.size > 0)
+        closeCSVMap(&map);
+
+    CategoryNode **categoryHash = workers[0].categoryHash;
+    long orderRecords = 0;
+    long jewelryRecords = 0;
+    for (int i = 0; i < numWorkers; i++)
+    {
+        if (i > 0)
+            mergeCategoryHash(categoryHash, workers[i].categoryHash);
+        orderRecords += workers[i].orders.recordsSpilled;
+        jewelryRecords += workers[i].jewelry.recordsSpilled;
+        freeRunBuilder(&workers[i].orders);
+        freeRunBuilder(&workers[i].jewelry);
+    }
+    free(workers);
+
+    printf("Runs de ordens: %d (media de %.0f registros por run)\n",
+           orderRunNum, orderRunNum ? (double)orderRecords / orderRunNum : 0.0);
+    printf("Runs de joias: %d (media de %.0f registros por run)\n",
+           jewelryRunNum, jewelryRunNum ? (double)jewelryRecords / jewelryRunNum : 0.0);
+
+    int categoryCount = 0;
+    CATEGORY *categoryBuffer = malloc(1000 * sizeof(CATEGORY));
+
+    for (int i = 0; i < 1000; i++)
+    {
+        CategoryNode *current = categoryHash[i];
+        while (current)
         {
-            startPosition = currentIndex.position;
-            left = middle + 1;
+            categoryBuffer[categoryCount].category_id = current->data.category_id;
+            strncpy(categoryBuffer[categoryCount].category_alias, current->data.category_alias,
+                    sizeof(categoryBuffer[categoryCount].category_alias) - 1);
+            categoryBuffer[categoryCount].product_count = 0;
+            categoryBuffer[categoryCount].total_sales = current->data.total_sales;
+            categoryBuffer[categoryCount].total_revenue = current->data.total_revenue;
+            categoryCount++;
+
+            CategoryNode *temp = current;
+            current = current->next;
+            free(temp);
         }
-        else
+    }
+
+    if (categoryCount > 0)
+    {
+        sortRecordsByKey(categoryBuffer, categoryCount, sizeof(CATEGORY), offsetof(CATEGORY, category_id));
+        FILE *f = openFile("../data/temp_category_run_0.dat", "wb");
+        if (f)
         {
-            right = middle - 1;
+            fwrite(categoryBuffer, sizeof(CATEGORY), categoryCount, f);
+            fclose(f);
         }
+        else
+            runWriteFailed = 1;
+        *numCategoryRuns = 1;
+    }
+    else
+    {
+        *numCategoryRuns = 0;
     }
 
-    JEWELRY *jewelry = malloc(sizeof(JEWELRY));
-    if (!jewelry)
-        return NULL;
-
-    fseek(jewelryRegister, startPosition, SEEK_SET);
+    free(categoryBuffer);
+    free(categoryHash);
 
-    for (int i = 0; i < indexGap; i++)
+    *numOrderRuns = orderRunNum;
+    *numJewelryRuns = jewelryRunNum;
+    if (runWriteFailed)
     {
-        if (fread(jewelry, sizeof(JEWELRY), 1, jewelryRegister) != 1)
-            break;
+        // Nada deste lote chega ao merge: os runs que chegaram a ser gravados sao apagados
+        removeRuns("order", orderRunNum);
+        removeRuns("jewelry", jewelryRunNum);
+        remove("../data/temp_category_run_0.dat");
+        return -1;
+    }
+    return orderRunNum;
+}
 
-        if (jewelry->product_id == product_id)
-            return jewelry;
-        if (jewelry->product_id > product_id)
-            break;
+int isOrderRemoved(ORDER *order)
+{
+    return (order->status == REMOVED_FLAG || order->status == FREE_FLAG);
+}
+
+// Slot de pagina ainda nao usado (tambem conta como removido para quem so quer ordens ativas)
+int isOrderFree(ORDER *order)
+{
+    return (order->status == FREE_FLAG);
+}
+
+// ------------------------------ Merge dos runs (arvore de perdedores) ------------------------------
+// Cada run e lido por um RUN_READER com buffer grande; a arvore de perdedores escolhe o menor
+// registro entre k runs com log2(k) comparacoes. Se houver mais runs que config.mergeFanIn,
+// os runs sao intercalados em varias passadas ate caberem em um unico merge.
+
+int openRunReader(RUN_READER *reader, const char *filename, size_t recordSize)
+{
+    reader->recordSize = recordSize;
+    reader->capacity = RUN_READ_BUFFER / recordSize;
+    if (reader->capacity < 1)
+        reader->capacity = 1;
+    reader->buffer = malloc(reader->capacity * recordSize);
+    reader->count = 0;
+    reader->pos = 0;
+    reader->finished = 0;
+    reader->file = fopen(filename, "rb");
+
+    if (!reader->file || !reader->buffer)
+    {
+        printf("Erro ao abrir run %s\n", filename);
+        reader->finished = 1;
+        return 0;
     }
 
-    free(jewelry);
-    return NULL;
+#ifdef POSIX_FADV_WILLNEED
+    // Pede ao kernel para ja ir lendo o run: com runs em discos diferentes, as leituras de
+    // todos os diretorios de spill acontecem em paralelo enquanto o merge consome os buffers.
+    posix_fadvise(fileno(reader->file), 0, 0, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(fileno(reader->file), 0, 2 * RUN_READ_BUFFER, POSIX_FADV_WILLNEED);
+#endif
+
+    reader->count = fread(reader->buffer, recordSize, reader->capacity, reader->file);
+    reader->finished = (reader->count == 0);
+    return 1;
 }
 
+void closeRunReader(RUN_READER *reader)
+{
+    if (reader->file)
+        fclose(reader->file);
+    free(reader->buffer);
+}
 
-// PERGUNTA: Qual a joia mais vendida? ----------------------------------------------------------------
-unsigned long hash(long long int product_id)
+void *runReaderCurrent(RUN_READER *reader)
 {
-    return product_id % HASH_SIZE;
+    if (reader->finished)
+        return NULL;
+    return reader->buffer + reader->pos * reader->recordSize;
 }
 
-void contMostSoldJewel(FILE *orderHistory, FILE *jewelryRegister, FILE *jewelryIndex, int indexGap)
+void runReaderAdvance(RUN_READER *reader)
 {
-    printf("\n=== PRODUTO MAIS VENDIDO ===\n");
+    if (reader->finished)
+        return;
 
-    HashNode **hashTable = calloc(HASH_SIZE, sizeof(HashNode *));
-    if (!hashTable)
-    {
-        printf("Erro ao alocar hash table.\n");
+    reader->pos++;
+    if (reader->pos < reader->count)
         return;
-    }
 
-    fseek(orderHistory, 0, SEEK_END);
-    long totalOrders = ftell(orderHistory) / sizeof(ORDER);
+    reader->count = fread(reader->buffer, reader->recordSize, reader->capacity, reader->file);
+    reader->pos = 0;
+    reader->finished = (reader->count == 0);
 
-    printf("Processando %ld pedidos...\n", totalOrders);
+#ifdef POSIX_FADV_WILLNEED
+    if (!reader->finished)
+        posix_fadvise(fileno(reader->file), ftell(reader->file), RUN_READ_BUFFER, POSIX_FADV_WILLNEED);
+#endif
+}
 
-    ORDER order;
-    fseek(orderHistory, 0, SEEK_SET);
-    int uniqueProducts = 0;
+// 1 se o run a deve sair antes do run b (runs terminados perdem sempre; empate pelo indice)
+int loserTreeBeats(LOSER_TREE *tree, int a, int b)
+{
+    void *recA = runReaderCurrent(&tree->readers[a]);
+    void *recB = runReaderCurrent(&tree->readers[b]);
 
-    for (long i = 0; i < totalOrders; i++)
-    {
-        if (fread(&order, sizeof(ORDER), 1, orderHistory) != 1)
-            break;
-        if (isOrderRemoved(&order))
-            continue;
+    if (!recA)
+        return 0;
+    if (!recB)
+        return 1;
 
-        unsigned long idx = hash(order.product_id);
-        HashNode *current = hashTable[idx];
-        HashNode *found = NULL;
+    long long keyA = recordKey(recA, tree->keyOffset);
+    long long keyB = recordKey(recB, tree->keyOffset);
+    if (keyA != keyB)
+        return keyA < keyB;
+    return a < b;
+}
 
-        while (current)
-        {
-            if (current->product_id == order.product_id)
-            {
-                found = current;
-                break;
-            }
-            current = current->next;
-        }
+void initLoserTree(LOSER_TREE *tree, RUN_READER *readers, int k, size_t keyOffset)
+{
+    tree->readers = readers;
+    tree->k = k;
+    tree->keyOffset = keyOffset;
+    tree->tree = malloc((k > 0 ? k : 1) * sizeof(int));
+    tree->tree[0] = 0;
+
+    if (k <= 1)
+        return;
+
+    // winners[n] = vencedor da subarvore n; folhas em winners[k..2k-1]
+    int *winners = malloc(2 * k * sizeof(int));
+    for (int i = 0; i < k; i++)
+        winners[k + i] = i;
+
+    for (int n = k - 1; n >= 1; n--)
+    {
+        int left = winners[2 * n];
+        int right = winners[2 * n + 1];
 
-        if (found)
+        if (loserTreeBeats(tree, left, right))
         {
-            found->total_quantity += order.quantity;
+            winners[n] = left;
+            tree->tree[n] = right;
         }
         else
         {
-            HashNode *newNode = malloc(sizeof(HashNode));
-            newNode->product_id = order.product_id;
-            newNode->total_quantity = order.quantity;
-            newNode->next = hashTable[idx];
-            hashTable[idx] = newNode;
-            uniqueProducts++;
-        }
-
-        if ((i + 1) % 10000 == 0)
-        {
-            printf("  %ld pedidos...\r", i + 1);
-            fflush(stdout);
+            winners[n] = right;
+            tree->tree[n] = left;
         }
     }
 
-    printf("\nProdutos unicos: %d\n", uniqueProducts);
+    tree->tree[0] = winners[1];
+    free(winners);
+}
 
-    PRODUCT_SALES *sales = malloc(uniqueProducts * sizeof(PRODUCT_SALES));
-    int count = 0;
+void freeLoserTree(LOSER_TREE *tree)
+{
+    free(tree->tree);
+}
 
-    for (int i = 0; i < HASH_SIZE; i++)
+// Menor registro ainda nao consumido, ou NULL quando todos os runs terminaram
+void *loserTreeTop(LOSER_TREE *tree)
+{
+    if (tree->k == 0)
+        return NULL;
+    return runReaderCurrent(&tree->readers[tree->tree[0]]);
+}
+
+void loserTreeAdvance(LOSER_TREE *tree)
+{
+    int winner = tree->tree[0];
+    runReaderAdvance(&tree->readers[winner]);
+
+    for (int n = (winner + tree->k) / 2; n >= 1; n /= 2)
     {
-        HashNode *current = hashTable[i];
-        while (current)
+        if (loserTreeBeats(tree, tree->tree[n], winner))
         {
-            sales[count].product_id = current->product_id;
-            sales[count].total_quantity = current->total_quantity;
-            count++;
-            HashNode *temp = current;
-            current = current->next;
-            free(temp);
+            int temp = tree->tree[n];
+            tree->tree[n] = winner;
+            winner = temp;
         }
     }
-    free(hashTable);
 
-    quicksort(sales, count, sizeof(PRODUCT_SALES), compareSales);
+    tree->tree[0] = winner;
+}
 
-    printf("\n=== TOP 10 ===\n");
-    printf("%-4s %-20s %-12s %-10s %-10s %-10s\n",
-           "Pos", "Product ID", "Quantidade", "Cor", "Metal", "Gema");
-    printf("----------------------------------------------------------------\n");
+RUN_READER *openRuns(const char *prefix, int first, int count, size_t recordSize)
+{
+    RUN_READER *readers = malloc((count > 0 ? count : 1) * sizeof(RUN_READER));
+    for (int i = 0; i < count; i++)
+    {
+        char filename[RUN_PATH_MAX];
+        runFileName(filename, prefix, first + i);
+        openRunReader(&readers[i], filename, recordSize);
+    }
+    return readers;
+}
 
-    int limit = (count < 10) ? count : 10;
-    for (int i = 0; i < limit; i++)
+// Fecha e apaga os runs [first, first + count)
+void closeRuns(const char *prefix, RUN_READER *readers, int first, int count)
+{
+    for (int i = 0; i < count; i++)
     {
-        JEWELRY *j = searchJewelryById(jewelryRegister, jewelryIndex, sales[i].product_id, indexGap);
+        char filename[RUN_PATH_MAX];
+        closeRunReader(&readers[i]);
+        runFileName(filename, prefix, first + i);
+        remove(filename);
+    }
+}
 
-        if (j)
+// Intercala os runs [first, first + count) de prefix em um unico arquivo
+void mergeRunGroup(const char *prefix, int first, int count, size_t recordSize,
+                   size_t keyOffset, const char *outputName)
+{
+    RUN_READER *readers = openRuns(prefix, first, count, recordSize);
+    LOSER_TREE tree;
+    initLoserTree(&tree, readers, count, keyOffset);
+
+    FILE *out = fopen(outputName, "wb");
+    long writeCapacity = RUN_READ_BUFFER / recordSize;
+    char *writeBuffer = malloc(writeCapacity * recordSize);
+    long writeCount = 0;
+    void *record;
+
+    while ((record = loserTreeTop(&tree)) != NULL)
+    {
+        memcpy(writeBuffer + writeCount * recordSize, record, recordSize);
+        if (++writeCount == writeCapacity)
         {
-            printf("%-4d %-20lld %-12d %-10s %-10s %-10s\n",
-                   i + 1, sales[i].product_id, sales[i].total_quantity,
-                   j->color, j->metal, j->gem);
-            free(j);
+            fwrite(writeBuffer, recordSize, writeCount, out);
+            writeCount = 0;
         }
+        loserTreeAdvance(&tree);
     }
-    printf("----------------------------------------------------------------\n\n");
 
-    free(sales);
-}
+    if (writeCount > 0)
+        fwrite(writeBuffer, recordSize, writeCount, out);
+    fclose(out);
 
+    freeLoserTree(&tree);
+    closeRuns(prefix, readers, first, count);
+    free(readers);
+    free(writeBuffer);
+}
 
-// ----------------------------- Reconstruir Index ----------------------------------
-int rebuildOrderIndex(FILE *orderHistory, FILE *orderIndex, int indexGap)
+// Passadas intermediarias enquanto numRuns + reserved > mergeFanIn; retorna o novo numero de runs.
+// reserved = leitores extras que o merge final abrira alem dos runs (ex.: arquivo existente).
+int reduceRuns(const char *prefix, int numRuns, size_t recordSize, size_t keyOffset, int reserved)
 {
-    fseek(orderHistory, 0, SEEK_END);
-    long totalRecords = ftell(orderHistory) / sizeof(ORDER);
-    fseek(orderIndex, 0, SEEK_SET); // Limpa o índice
-
-    ORDER order;
-    int indexCount = 0;
-    int activeCount = 0;
+    int fanIn = (config.mergeFanIn >= 2) ? config.mergeFanIn : 2;
+    int finalFanIn = (fanIn - reserved >= 1) ? fanIn - reserved : 1;
 
-    fseek(orderHistory, 0, SEEK_SET);
-
-    for (long i = 0; i < totalRecords; i++)
+    while (numRuns > finalFanIn)
     {
-        long currentPos = ftell(orderHistory);
-        if (fread(&order, sizeof(ORDER), 1, orderHistory) != 1)
-            break;
-
-        if (order.data[0] == REMOVED_FLAG)
-            continue; // Ignora removidos
+        int groups = (numRuns + fanIn - 1) / fanIn;
 
-        activeCount++;
+        for (int g = 0; g < groups; g++)
+        {
+            int first = g * fanIn;
+            int count = (numRuns - first < fanIn) ? numRuns - first : fanIn;
+            char mergedName[RUN_PATH_MAX];
+            mergeFileName(mergedName, prefix, g);
+            mergeRunGroup(prefix, first, count, recordSize, keyOffset, mergedName);
+        }
 
-        if (activeCount % indexGap == 1 || activeCount == 1)
+        for (int g = 0; g < groups; g++)
         {
-            INDEX indexEntry = {order.order_id, currentPos};
-            fwrite(&indexEntry, sizeof(INDEX), 1, orderIndex);
-            indexCount++;
+            char mergedName[RUN_PATH_MAX];
+            char filename[RUN_PATH_MAX];
+            mergeFileName(mergedName, prefix, g);
+            runFileName(filename, prefix, g);
+            rename(mergedName, filename);
         }
-    }
 
-    fflush(orderIndex);
+        printf("  Merge intermediario (%s): %d runs -> %d runs\n", prefix, numRuns, groups);
+        numRuns = groups;
+    }
 
-    return indexCount;
+    return numRuns;
 }
 
-int rebuildJewelryIndex(FILE *jewelryRegister, FILE *jewelryIndex, int indexGap)
+// ------------------------------ Indice aprendido (order_id -> registro) ------------------------------
+// Os order_id crescem quase linearmente com a posicao em orderHistory.dat. No merge, segmentos
+// lineares sao ajustados (cone que encolhe, como no PGM) de forma que a posicao prevista de cada
+// chave erre no maximo PLA_EPSILON registros; a busca le so a janela prevista, em uma leitura.
+
+void initPlaBuilder(PLA_BUILDER *builder, LEARNED_INDEX *index)
 {
-    fseek(jewelryRegister, 0, SEEK_END);
-    long totalRecords = ftell(jewelryRegister) / sizeof(JEWELRY);
+    memset(builder, 0, sizeof(PLA_BUILDER));
+    builder->index = index;
+    free(index->segments);
+    memset(index, 0, sizeof(LEARNED_INDEX));
+}
 
-    if (totalRecords == 0)
+void plaCloseSegment(PLA_BUILDER *builder)
+{
+    LEARNED_INDEX *index = builder->index;
+    if (index->count == index->capacity)
     {
-        printf("Arquivo de joias vazio. Nao ha indice para reconstruir.\n");
-        return 0;
+        index->capacity = index->capacity * 2 + 16;
+        index->segments = realloc(index->segments, index->capacity * sizeof(PLA_SEGMENT));
     }
 
-    fseek(jewelryIndex, 0, SEEK_SET);
+    PLA_SEGMENT *segment = &index->segments[index->count++];
+    segment->firstKey = builder->startKey;
+    segment->firstRank = builder->startRank;
+    segment->slope = builder->slopeHigh < 0 ? builder->slopeLow : (builder->slopeLow + builder->slopeHigh) / 2;
+}
 
-    JEWELRY jewelry;
-    int indexCount = 0;
+// Recebe as chaves em ordem; so a primeira ocorrencia de cada order_id vira ponto do ajuste
+void plaBuilderAdd(PLA_BUILDER *builder, long long key, long rank)
+{
+    builder->index->recordCount = rank + 1;
+    builder->index->maxKey = key;
 
-    fseek(jewelryRegister, 0, SEEK_SET);
+    if (builder->points > 0 && key == builder->lastKey)
+        return;
+    builder->lastKey = key;
 
-    for (long i = 0; i < totalRecords; i++)
+    if (builder->points++ == 0)
     {
-        long currentPos = ftell(jewelryRegister);
+        builder->startKey = key;
+        builder->startRank = rank;
+        builder->slopeLow = 0;
+        builder->slopeHigh = -1; // Sem limite superior ate o segundo ponto
+        return;
+    }
 
-        if (fread(&jewelry, sizeof(JEWELRY), 1, jewelryRegister) != 1)
-        {
-            printf("Erro ao ler registro %ld\n", i);
-            break;
-        }
+    double dx = (double)(key - builder->startKey);
+    double low = (rank - PLA_EPSILON - builder->startRank) / dx;
+    double high = (rank + PLA_EPSILON - builder->startRank) / dx;
 
-        if (i % indexGap == 0)
-        {
-            INDEX indexEntry = {
-                jewelry.product_id,
-                currentPos};
-            fwrite(&indexEntry, sizeof(INDEX), 1, jewelryIndex);
-            indexCount++;
-        }
+    if (builder->slopeHigh >= 0 && (low > builder->slopeHigh || high < builder->slopeLow))
+    {
+        plaCloseSegment(builder);
+        builder->startKey = key;
+        builder->startRank = rank;
+        builder->slopeLow = 0;
+        builder->slopeHigh = -1;
+        return;
     }
 
-    long newIndexSize = indexCount * sizeof(INDEX);
-    fflush(jewelryIndex);
-
-#ifdef _WIN32
-    _chsize(_fileno(jewelryIndex), newIndexSize);
-#else
-    ftruncate(fileno(jewelryIndex), newIndexSize);
-#endif
+    if (low > builder->slopeLow)
+        builder->slopeLow = low;
+    if (builder->slopeHigh < 0 || high < builder->slopeHigh)
+        builder->slopeHigh = high;
+}
 
-    printf("Indice de joias reconstruido com sucesso: %d entradas.\n", indexCount);
-    return indexCount;
+void plaBuilderFinish(PLA_BUILDER *builder)
+{
+    if (builder->points > 0)
+        plaCloseSegment(builder);
 }
 
-void rebuildCategoryData(FILE *orderHistory, FILE *categoryRegister,
-                         FILE *categoryIndex, int indexGap)
+// O .pla guarda a contagem exata e o checksum do arquivo ajustado: so vale para esse arquivo
+void saveLearnedIndex(LEARNED_INDEX *index, FILE *orderHistory)
 {
-    printf("\n=== RECONSTRUINDO DADOS DE CATEGORIAS ===\n");
+    long size;
+    fflush(orderHistory);
+    index->checksum = streamChecksum(orderHistory, &size, MANIFEST_SAMPLE_BYTES);
 
-    // Hash table para agregação
-    CategoryNode **categoryHash = calloc(1000, sizeof(CategoryNode *));
+    FILE *f = openFile("../data/orderIndex.pla", "wb");
+    if (!f)
+        return;
 
-    fseek(orderHistory, 0, SEEK_END);
-    long totalOrders = ftell(orderHistory) / sizeof(ORDER);
-    fseek(orderHistory, 0, SEEK_SET);
+    int epsilon = PLA_EPSILON;
+    fwrite(&epsilon, sizeof(int), 1, f);
+    fwrite(&index->recordCount, sizeof(long), 1, f);
+    fwrite(&index->maxKey, sizeof(long long), 1, f);
+    fwrite(&index->checksum, sizeof(unsigned long long), 1, f);
+    fwrite(&index->count, sizeof(int), 1, f);
+    fwrite(index->segments, sizeof(PLA_SEGMENT), index->count, f);
+    fclose(f);
+}
 
-    printf("Processando %ld pedidos...\n", totalOrders);
+// Ajusta os segmentos lendo orderHistory.dat (quando nao ha .pla do ultimo merge)
+void fitLearnedIndex(FILE *orderHistory, LEARNED_INDEX *index)
+{
+    PLA_BUILDER builder;
+    initPlaBuilder(&builder, index);
 
-    ORDER order;
-    for (long i = 0; i < totalOrders; i++)
+    RUN_READER reader;
+    fflush(orderHistory);
+    if (!openRunReader(&reader, "../data/orderHistory.dat", sizeof(ORDER)))
+        return;
+
+    ORDER *order;
+    long rank = 0;
+    while ((order = runReaderCurrent(&reader)) != NULL)
     {
-        if (fread(&order, sizeof(ORDER), 1, orderHistory) != 1)
-            break;
+        plaBuilderAdd(&builder, order->order_id, rank++);
+        runReaderAdvance(&reader);
+    }
+    closeRunReader(&reader);
 
-        int hashIdx = order.category_id % 1000;
-        CategoryNode *current = categoryHash[hashIdx];
-        CategoryNode *found = NULL;
+    plaBuilderFinish(&builder);
+    saveLearnedIndex(index, orderHistory);
+}
 
-        while (current)
+// Carrega o .pla; se faltar ou nao servir para o arquivo atual, ajusta de novo
+void loadLearnedIndex(FILE *orderHistory, LEARNED_INDEX *index)
+{
+    free(index->segments);
+    memset(index, 0, sizeof(LEARNED_INDEX));
+
+    long size;
+    unsigned long long checksum = streamChecksum(orderHistory, &size, MANIFEST_SAMPLE_BYTES);
+    long records = size / sizeof(ORDER);
+
+    FILE *f = fopen("../data/orderIndex.pla", "rb");
+    int epsilon = 0, ok = 0;
+    if (f)
+    {
+        ok = fread(&epsilon, sizeof(int), 1, f) == 1 &&
+             fread(&index->recordCount, sizeof(long), 1, f) == 1 &&
+             fread(&index->maxKey, sizeof(long long), 1, f) == 1 &&
+             fread(&index->checksum, sizeof(unsigned long long), 1, f) == 1 &&
+             fread(&index->count, sizeof(int), 1, f) == 1 &&
+             epsilon == PLA_EPSILON && index->recordCount == records && index->checksum == checksum &&
+             index->count >= 0;
+        if (ok)
         {
-            if (current->data.category_id == order.category_id)
-            {
-                found = current;
-                break;
-            }
-            current = current->next;
+            index->capacity = index->count;
+            index->segments = malloc((index->count + 1) * sizeof(PLA_SEGMENT));
+            ok = fread(index->segments, sizeof(PLA_SEGMENT), index->count, f) == (size_t)index->count;
         }
+        fclose(f);
+    }
+
+    if (!ok)
+        fitLearnedIndex(orderHistory, index);
+
+    printf("Indice aprendido: %d segmentos (%ld bytes), erro maximo %d registros\n",
+           index->count, (long)(index->count * sizeof(PLA_SEGMENT)), PLA_EPSILON);
+}
 
-        if (found)
+long predictRank(LEARNED_INDEX *index, long long key)
+{
+    int left = 0, right = index->count - 1, found = -1;
+    while (left <= right)
+    {
+        int middle = left + (right - left) / 2;
+        if (index->segments[middle].firstKey <= key)
         {
-            found->data.total_sales += order.quantity;
-            found->data.total_revenue += (order.price_usd * order.quantity);
+            found = middle;
+            left = middle + 1;
         }
         else
         {
-            CategoryNode *newNode = malloc(sizeof(CategoryNode));
-            newNode->data.category_id = order.category_id;
-            strncpy(newNode->data.category_alias, order.category_alias, sizeof(newNode->data.category_alias) - 1);
-            newNode->data.product_count = 0;
-            newNode->data.total_sales = order.quantity;
-            newNode->data.total_revenue = (order.price_usd * order.quantity);
-            newNode->next = categoryHash[hashIdx];
-            categoryHash[hashIdx] = newNode;
-        }
-
-        if ((i + 1) % 10000 == 0)
-        {
-            printf("  %ld pedidos...\r", i + 1);
-            fflush(stdout);
+            right = middle - 1;
         }
     }
+    if (found < 0)
+        return 0;
 
-    printf("\n");
+    PLA_SEGMENT *segment = &index->segments[found];
+    return segment->firstRank + (long)(segment->slope * (double)(key - segment->firstKey) + 0.5);
+}
 
-    int categoryCount = 0;
-    CATEGORY *categories = malloc(1000 * sizeof(CATEGORY));
+// 1 = encontrada, 0 = com certeza nao esta no arquivo principal,
+// -1 = a janela nao basta (registros acrescentados depois do ajuste) e a busca por bloco decide
+int learnedSearch(FILE *orderHistory, LEARNED_INDEX *index, long long key, ORDER *out)
+{
+    ORDER window[2 * PLA_EPSILON + 1];
+    long first = predictRank(index, key) - PLA_EPSILON;
+    if (first < 0)
+        first = 0;
 
-    for (int i = 0; i < 1000; i++)
+    fseek(orderHistory, first * sizeof(ORDER), SEEK_SET);
+    long count = fread(window, sizeof(ORDER), 2 * PLA_EPSILON + 1, orderHistory);
+
+    for (long i = 0; i < count; i++)
     {
-        CategoryNode *current = categoryHash[i];
-        while (current)
+        if (window[i].order_id == key && !isOrderRemoved(&window[i]))
         {
-            categories[categoryCount].category_id = current->data.category_id;
-            strncpy(categories[categoryCount].category_alias, current->data.category_alias,
-                    sizeof(categories[categoryCount].category_alias) - 1);
-            categories[categoryCount].product_count = current->data.product_count;
-            categories[categoryCount].total_sales = current->data.total_sales;
-            categories[categoryCount].total_revenue = current->data.total_revenue;
-            categoryCount++;
-
-            CategoryNode *temp = current;
-            current = current->next;
-            free(temp);
+            *out = window[i];
+            return 1;
         }
     }
 
-    quicksort(categories, categoryCount, sizeof(CATEGORY), compareCategory);
+    // So e ausencia certa se a janela cerca a chave: insercoes nas paginas deslocam registros
+    // para a direita, e chaves novas nao tem posicao prevista pelo ajuste.
+    if (count == 0 || window[0].order_id >= key || window[count - 1].order_id <= key || key >= index->maxKey)
+        return -1;
+    return 0;
+}
 
-    fseek(categoryRegister, 0, SEEK_SET);
-    fseek(categoryIndex, 0, SEEK_SET);
+// ------------------------------ Filtros de Bloom por bloco ------------------------------
+// Um filtro por bloco do indice de ordens (registros do arquivo principal e do overflow).
+// Uma busca por order_id inexistente e descartada em memoria, sem ler pagina de dados.
 
-    for (int i = 0; i < categoryCount; i++)
-    {
-        long pos = i * sizeof(CATEGORY);
-        fwrite(&categories[i], sizeof(CATEGORY), 1, categoryRegister);
+unsigned long long bloomHash(long long key)
+{
+    unsigned long long h = (unsigned long long)key;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
 
-        if (i % indexGap == 0)
-        {
-            INDEX indexEntry = {categories[i].category_id, pos};
-            fwrite(&indexEntry, sizeof(INDEX), 1, categoryIndex);
-        }
-    }
+void initBloomFilter(BLOOM_FILTER *bloom, int indexGap)
+{
+    free(bloom->bits);
+    memset(bloom, 0, sizeof(BLOOM_FILTER));
+    bloom->wordsPerBlock = ((long)indexGap * BLOOM_BITS_PER_KEY + 63) / 64;
+}
 
-    ftruncate(fileno(categoryRegister), categoryCount * sizeof(CATEGORY));
-    ftruncate(fileno(categoryIndex), ((categoryCount + indexGap - 1) / indexGap) * sizeof(INDEX));
+void bloomEnsureBlocks(BLOOM_FILTER *bloom, long blocks)
+{
+    if (blocks <= bloom->blocks)
+        return;
 
-    fflush(categoryRegister);
-    fflush(categoryIndex);
+    long newBlocks = bloom->blocks * 2 > blocks ? bloom->blocks * 2 : blocks;
+    bloom->bits = realloc(bloom->bits, newBlocks * bloom->wordsPerBlock * sizeof(unsigned long long));
+    memset(bloom->bits + bloom->blocks * bloom->wordsPerBlock, 0,
+           (newBlocks - bloom->blocks) * bloom->wordsPerBlock * sizeof(unsigned long long));
+    bloom->blocks = newBlocks;
+}
 
-    free(categories);
-    free(categoryHash);
+// Hashing duplo: os BLOOM_HASHES bits saem de h1 + i * h2
+void bloomAdd(BLOOM_FILTER *bloom, long block, long long key)
+{
+    bloomEnsureBlocks(bloom, block + 1);
 
-    printf("Categorias reconstruidas: %d registros\n\n", categoryCount);
+    unsigned long long *words = bloom->bits + block * bloom->wordsPerBlock;
+    unsigned long long bitCount = bloom->wordsPerBlock * 64;
+    unsigned long long h = bloomHash(key);
+    unsigned long long h1 = h, h2 = (h >> 32) | 1;
+
+    for (int i = 0; i < BLOOM_HASHES; i++)
+    {
+        unsigned long long bit = (h1 + i * h2) % bitCount;
+        words[bit / 64] |= 1ULL << (bit % 64);
+    }
 }
 
-void rebuildAllIndices(FILE *orderHistory, FILE *orderIndex, FILE *categoryRegister,
-                       FILE *categoryIndex, int indexGap)
+int bloomMayContain(BLOOM_FILTER *bloom, long block, long long key)
 {
+    if (block < 0 || block >= bloom->blocks)
+        return 1;
 
-    printf("\n\n=============== REORGANIZACAO GERAL DO SISTEMA ===============\n");
+    unsigned long long *words = bloom->bits + block * bloom->wordsPerBlock;
+    unsigned long long bitCount = bloom->wordsPerBlock * 64;
+    unsigned long long h = bloomHash(key);
+    unsigned long long h1 = h, h2 = (h >> 32) | 1;
 
-    rebuildOrderIndex(orderHistory, orderIndex, indexGap);
-    rebuildCategoryData(orderHistory, categoryRegister, categoryIndex, indexGap);
+    for (int i = 0; i < BLOOM_HASHES; i++)
+    {
+        unsigned long long bit = (h1 + i * h2) % bitCount;
+        if (!(words[bit / 64] & (1ULL << (bit % 64))))
+            return 0;
+    }
+    return 1;
+}
 
-    removal_count = 0;
+void saveBloomFilter(BLOOM_FILTER *bloom, long usedBlocks)
+{
+    FILE *f = openFile("../data/orderBloom.bf", "wb");
+    if (!f)
+        return;
 
-    printf("==============================================================\n");
-    printf("TODOS OS INDICES E DADOS DE CADASTRO FORAM RECONSTRUIDOS.\n\n");
+    fwrite(&usedBlocks, sizeof(long), 1, f);
+    fwrite(&bloom->wordsPerBlock, sizeof(long), 1, f);
+    fwrite(bloom->bits, sizeof(unsigned long long), usedBlocks * bloom->wordsPerBlock, f);
+    fclose(f);
 }
 
-void showOrderHistory(FILE *orderHistory)
+// ------------------------------ Indice secundario por product_id ------------------------------
+// product_id -> lista dos registros de orderHistory.dat com aquele produto, em ordem crescente e
+// gravada como diferencas em varint. Montado no mesmo merge que grava o indice primario; as
+// ordens inseridas depois vao para um log (productIndex.log) ate a proxima carga.
+
+void addProductPosting(PRODUCT_INDEX *index, long long product_id, long location)
 {
-    fseek(orderHistory, 0, SEEK_END);
-    long total = ftell(orderHistory) / sizeof(ORDER);
+    if (index->pendingCount == index->pendingCapacity)
+    {
+        index->pendingCapacity = index->pendingCapacity * 2 + 1024;
+        index->pending = realloc(index->pending, index->pendingCapacity * sizeof(PRODUCT_POSTING));
+    }
+    index->pending[index->pendingCount].product_id = product_id;
+    index->pending[index->pendingCount].location = location;
+    index->pendingCount++;
+}
 
-    printf("\nTotal registros: %ld\n", total);
+void freeProductIndex(PRODUCT_INDEX *index)
+{
+    free(index->entries);
+    free(index->postings);
+    free(index->pending);
+    free(index->log);
+    memset(index, 0, sizeof(PRODUCT_INDEX));
+}
 
-    ORDER order;
-    fseek(orderHistory, 0, SEEK_SET);
+int encodeVarint(unsigned char *out, unsigned long value)
+{
+    int length = 0;
+    while (value >= 0x80)
+    {
+        out[length++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (unsigned char)value;
+    return length;
+}
 
-    printf("\nPrimeiros 5:\n");
-    for (int i = 0; i < 5 && i < total; i++)
+unsigned long decodeVarint(const unsigned char **ptr)
+{
+    unsigned long value = 0;
+    int shift = 0;
+    while (**ptr & 0x80)
     {
-        if (fread(&order, sizeof(ORDER), 1, orderHistory) == 1)
+        value |= (unsigned long)(**ptr & 0x7f) << shift;
+        shift += 7;
+        (*ptr)++;
+    }
+    value |= (unsigned long)**ptr << shift;
+    (*ptr)++;
+    return value;
+}
+
+// Ordena os pares pendentes por produto e grava diretorio + listas; o log comeca vazio
+void finishProductIndex(PRODUCT_INDEX *index, long recordCount)
+{
+    // Ordenacao estavel: dentro de um produto os registros continuam crescentes
+    sortRecordsByKey(index->pending, index->pendingCount, sizeof(PRODUCT_POSTING),
+                     offsetof(PRODUCT_POSTING, product_id));
+
+    free(index->entries);
+    free(index->postings);
+    index->entries = malloc((index->pendingCount + 1) * sizeof(PRODUCT_ENTRY));
+    index->postings = malloc(index->pendingCount * 10 + 1);
+    index->count = 0;
+    index->postingsSize = 0;
+    index->recordCount = recordCount;
+
+    for (long i = 0; i < index->pendingCount; i++)
+    {
+        PRODUCT_POSTING *posting = &index->pending[i];
+        PRODUCT_ENTRY *entry = &index->entries[index->count - 1];
+        long previous = 0;
+
+        if (index->count == 0 || entry->product_id != posting->product_id)
+        {
+            entry = &index->entries[index->count++];
+            entry->product_id = posting->product_id;
+            entry->offset = index->postingsSize;
+            entry->count = 0;
+        }
+        else
         {
-            printf("%d. ID: %lld, Data: %s\n", i + 1, order.order_id, order.data);
+            previous = index->pending[i - 1].location;
         }
+
+        index->postingsSize += encodeVarint(index->postings + index->postingsSize, posting->location - previous);
+        entry->count++;
     }
 
-    printf("\nUltimos 5:\n");
-    long start = (total > 5) ? total - 5 : 0;
-    fseek(orderHistory, start * sizeof(ORDER), SEEK_SET);
+    free(index->pending);
+    index->pending = NULL;
+    index->pendingCount = 0;
+    index->pendingCapacity = 0;
+    index->logCount = 0;
 
-    for (int i = 0; i < 5 && start + i < total; i++)
+    FILE *f = openFile("../data/productIndex.dat", "wb");
+    if (f)
     {
-        if (fread(&order, sizeof(ORDER), 1, orderHistory) == 1)
-        {
-            printf("%ld. ID: %lld, Data: %s\n", start + i + 1, order.order_id, order.data);
-        }
+        fwrite(&index->recordCount, sizeof(long), 1, f);
+        fwrite(&index->count, sizeof(long), 1, f);
+        fwrite(&index->postingsSize, sizeof(long), 1, f);
+        fwrite(index->entries, sizeof(PRODUCT_ENTRY), index->count, f);
+        fwrite(index->postings, 1, index->postingsSize, f);
+        fclose(f);
     }
-    printf("\n");
+
+    FILE *log = fopen("../data/productIndex.log", "wb");
+    if (log)
+        fclose(log);
 }
 
-void showJewelryRegister(FILE *jewelryRegister)
+// Ordem inserida depois do merge: location >= 0 e o registro no arquivo principal,
+// location < 0 e -(offset + 1) no overflow
+void logProductPostings(PRODUCT_POSTING *postings, long count)
 {
-    fseek(jewelryRegister, 0, SEEK_END);
-    long total = ftell(jewelryRegister) / sizeof(JEWELRY);
+    if (count <= 0)
+        return;
 
-    printf("\nTotal joias: %ld\n", total);
+    productIndex.log = realloc(productIndex.log, (productIndex.logCount + count) * sizeof(PRODUCT_POSTING));
+    memcpy(&productIndex.log[productIndex.logCount], postings, count * sizeof(PRODUCT_POSTING));
 
-    JEWELRY jewelry;
-    fseek(jewelryRegister, 0, SEEK_SET);
+    FILE *log = fopen("../data/productIndex.log", "ab");
+    if (log)
+    {
+        fwrite(postings, sizeof(PRODUCT_POSTING), count, log);
+        fclose(log);
+    }
+    productIndex.logCount += count;
+}
 
-    printf("\nPrimeiras 5:\n");
-    for (int i = 0; i < 5 && i < total; i++)
+void logProductPosting(long long product_id, long location)
+{
+    PRODUCT_POSTING posting = {product_id, location};
+    logProductPostings(&posting, 1);
+}
+
+// Refaz o indice secundario lendo orderHistory.dat; ordens do overflow vao para o log
+void rebuildProductIndex(FILE *orderHistory, FILE *orderOverflow)
+{
+    freeProductIndex(&productIndex);
+
+    RUN_READER reader;
+    long record = 0;
+    fflush(orderHistory);
+    if (openRunReader(&reader, "../data/orderHistory.dat", sizeof(ORDER)))
     {
-        if (fread(&jewelry, sizeof(JEWELRY), 1, jewelryRegister) == 1)
+        ORDER *order;
+        while ((order = runReaderCurrent(&reader)) != NULL)
         {
-            printf("%d. Product ID: %lld, Cor: %s\n", i + 1, jewelry.product_id, jewelry.color);
+            if (!isOrderFree(order))
+                addProductPosting(&productIndex, order->product_id, record);
+            record++;
+            runReaderAdvance(&reader);
         }
+        closeRunReader(&reader);
     }
-    printf("\n");
+    finishProductIndex(&productIndex, record);
+
+    OVERFLOW_RECORD overflow;
+    fseek(orderOverflow, 0, SEEK_SET);
+    for (long offset = 0; fread(&overflow, sizeof(OVERFLOW_RECORD), 1, orderOverflow) == 1;
+         offset += sizeof(OVERFLOW_RECORD))
+        logProductPosting(overflow.record.product_id, -(offset + 1));
 }
 
-void showFileStats(FILE *orderHistory, FILE *orderOverflow)
+// ------------------------------ Zone maps por bloco ------------------------------
+// Minimo e maximo de data, produto, categoria, usuario e preco de cada bloco do arquivo de ordens
+// (mais o overflow do bloco). Uma consulta com filtros pula os blocos cujo intervalo nao casa.
+
+void initZoneMaps(ZONE_MAPS *maps)
 {
-    printf("\n=== ESTATISTICAS ===\n");
+    free(maps->zones);
+    memset(maps, 0, sizeof(ZONE_MAPS));
+}
 
-    fseek(orderHistory, 0, SEEK_END);
-    long totalRecords = ftell(orderHistory) / sizeof(ORDER);
+void zoneMapsEnsureBlocks(ZONE_MAPS *maps, long blocks)
+{
+    if (blocks <= maps->count)
+        return;
 
-    ORDER order;
-    int active = 0, removed = 0;
+    maps->zones = realloc(maps->zones, blocks * sizeof(ZONE_MAP));
+    for (long b = maps->count; b < blocks; b++)
+    {
+        ZONE_MAP *zone = &maps->zones[b];
+        zone->minDate = zone->minProduct = zone->minCategory = zone->minUser = LLONG_MAX;
+        zone->maxDate = zone->maxProduct = zone->maxCategory = zone->maxUser = LLONG_MIN;
+        zone->minPrice = 1e30f;
+        zone->maxPrice = -1e30f;
+    }
+    maps->count = blocks;
+}
 
-    fseek(orderHistory, 0, SEEK_SET);
-    for (long i = 0; i < totalRecords; i++)
+void zoneAdd(ZONE_MAPS *maps, long block, ORDER *order)
+{
+    zoneMapsEnsureBlocks(maps, block + 1);
+    ZONE_MAP *zone = &maps->zones[block];
+
+    long long date = order->date;
+    if (date >= 0)
     {
-        if (fread(&order, sizeof(ORDER), 1, orderHistory) != 1)
-            break;
-        if (isOrderRemoved(&order))
-            removed++;
+        if (date < zone->minDate)
+            zone->minDate = date;
+        if (date > zone->maxDate)
+            zone->maxDate = date;
+    }
+    if (order->product_id < zone->minProduct)
+        zone->minProduct = order->product_id;
+    if (order->product_id > zone->maxProduct)
+        zone->maxProduct = order->product_id;
+    if (order->category_id < zone->minCategory)
+        zone->minCategory = order->category_id;
+    if (order->category_id > zone->maxCategory)
+        zone->maxCategory = order->category_id;
+    if (order->user_id < zone->minUser)
+        zone->minUser = order->user_id;
+    if (order->user_id > zone->maxUser)
+        zone->maxUser = order->user_id;
+    float price = centsToUsd(order->price_cents);
+    if (price < zone->minPrice)
+        zone->minPrice = price;
+    if (price > zone->maxPrice)
+        zone->maxPrice = price;
+}
+
+void saveZoneMaps(ZONE_MAPS *maps, long blocks)
+{
+    zoneMapsEnsureBlocks(maps, blocks);
+
+    FILE *f = openFile("../data/orderZones.zm", "wb");
+    if (!f)
+        return;
+    fwrite(&blocks, sizeof(long), 1, f);
+    fwrite(maps->zones, sizeof(ZONE_MAP), blocks, f);
+    fclose(f);
+}
+
+// ------------------------------ Indices bitmap (Roaring) ------------------------------
+// gender, metal, gem, color e category_id tem poucos valores: cada valor guarda o conjunto de
+// ordinais das ordens que o possuem. Consultas combinam os conjuntos sem ler orderHistory.dat.
+
+const char *bitmapFieldNames[BITMAP_FIELDS] = {"Gender", "Metal", "Gem", "Color", "Category ID"};
+
+void freeRoaring(ROARING *r)
+{
+    for (int i = 0; i < r->count; i++)
+    {
+        free(r->containers[i].array);
+        free(r->containers[i].bits);
+    }
+    free(r->containers);
+    memset(r, 0, sizeof(ROARING));
+}
+
+// Indice do container com a key; cria um vazio na posicao certa se create
+int roaringContainer(ROARING *r, unsigned short key, int create)
+{
+    int left = 0, right = r->count - 1;
+    while (left <= right)
+    {
+        int middle = (left + right) / 2;
+        if (r->containers[middle].key == key)
+            return middle;
+        if (r->containers[middle].key < key)
+            left = middle + 1;
         else
-            active++;
+            right = middle - 1;
     }
+    if (!create)
+        return -1;
 
-    int overflowCount = 0;
-    if (orderOverflow)
+    if (r->count == r->capacity)
     {
-        fseek(orderOverflow, 0, SEEK_END);
-        overflowCount = ftell(orderOverflow) / sizeof(OVERFLOW_RECORD);
+        r->capacity = r->capacity ? r->capacity * 2 : 4;
+        r->containers = realloc(r->containers, r->capacity * sizeof(ROARING_CONTAINER));
     }
+    memmove(&r->containers[left + 1], &r->containers[left], (r->count - left) * sizeof(ROARING_CONTAINER));
+    memset(&r->containers[left], 0, sizeof(ROARING_CONTAINER));
+    r->containers[left].key = key;
+    r->count++;
+    return left;
+}
 
-    printf("Registros totais:    %ld\n", totalRecords);
-    printf("Registros ativos:    %d (%.1f%%)\n", active, (active * 100.0) / totalRecords);
-    printf("Registros removidos: %d (%.1f%%)\n", removed, (removed * 100.0) / totalRecords);
-    printf("Registros overflow:  %d\n", overflowCount);
-    printf("Tamanho arquivo:     %.2f MB\n", (totalRecords * sizeof(ORDER)) / (1024.0 * 1024.0));
+int containerFind(ROARING_CONTAINER *c, unsigned short low)
+{
+    int left = 0, right = c->cardinality;
+    while (left < right)
+    {
+        int middle = (left + right) / 2;
+        if (c->array[middle] < low)
+            left = middle + 1;
+        else
+            right = middle;
+    }
+    return left;
+}
 
-    if (overflowCount > totalRecords * 0.05)
+// Copia o container para ROARING_WORDS palavras
+void containerToWords(ROARING_CONTAINER *c, unsigned long long *words)
+{
+    if (c->bits)
     {
-        printf("\nAVISO: Muitos registros em overflow (>5%%)\n");
-        printf("Recomenda-se reorganizar o arquivo!\n");
+        memcpy(words, c->bits, ROARING_WORDS * sizeof(unsigned long long));
+        return;
     }
-    printf("\n");
+    memset(words, 0, ROARING_WORDS * sizeof(unsigned long long));
+    for (int i = 0; i < c->cardinality; i++)
+        words[c->array[i] >> 6] |= 1ULL << (c->array[i] & 63);
 }
 
-int removeOrder(FILE *orderHistory, FILE *orderIndex, FILE *orderOverflow,
-                long long int target_id, int indexGap)
+// Monta o container a partir das palavras, como vetor se couber
+void containerFromWords(ROARING_CONTAINER *c, const unsigned long long *words)
 {
-    ORDER *order = searchOrderById(orderHistory, orderIndex, orderOverflow, target_id, indexGap);
+    int cardinality = 0;
+    for (int w = 0; w < ROARING_WORDS; w++)
+        cardinality += POPCOUNT(words[w]);
+
+    free(c->array);
+    free(c->bits);
+    c->array = NULL;
+    c->bits = NULL;
+    c->cardinality = cardinality;
+    c->capacity = 0;
+
+    if (cardinality > ROARING_ARRAY_MAX)
+    {
+        c->bits = malloc(ROARING_WORDS * sizeof(unsigned long long));
+        memcpy(c->bits, words, ROARING_WORDS * sizeof(unsigned long long));
+        return;
+    }
 
-    if (!order)
+    c->array = malloc((cardinality + 1) * sizeof(unsigned short));
+    c->capacity = cardinality;
+    int n = 0;
+    for (int w = 0; w < ROARING_WORDS; w++)
     {
-        printf("Ordem nao encontrada.\n");
-        return 0;
+        for (unsigned long long word = words[w]; word; word &= word - 1)
+            c->array[n++] = (unsigned short)(w * 64 + TRAILING_ZEROS(word));
     }
+}
 
-    printf("Ordem encontrada:\n");
-    printf("  Order ID: %lld\n", order->order_id);
-    printf("  Data: %s\n", order->data);
-    printf("  Quantidade: %d\n", order->quantity);
-    printf("  Preco: %.2f USD\n", order->price_usd);
+void roaringAdd(ROARING *r, unsigned int value)
+{
+    int index = roaringContainer(r, value >> 16, 1);
+    ROARING_CONTAINER *c = &r->containers[index];
+    unsigned short low = value & 0xFFFF;
 
-    printf("\nConfirma remocao? (s/n): ");
-    char confirm;
-    scanf(" %c", &confirm);
+    if (c->bits)
+    {
+        unsigned long long mask = 1ULL << (low & 63);
+        if (!(c->bits[low >> 6] & mask))
+        {
+            c->bits[low >> 6] |= mask;
+            c->cardinality++;
+        }
+        return;
+    }
 
-    if (confirm != 's' && confirm != 'S')
+    int slot = containerFind(c, low);
+    if (slot < c->cardinality && c->array[slot] == low)
+        return;
+
+    if (c->cardinality == ROARING_ARRAY_MAX)
     {
-        printf("Remocao cancelada.\n");
-        free(order);
+        unsigned long long words[ROARING_WORDS];
+        containerToWords(c, words);
+        words[low >> 6] |= 1ULL << (low & 63);
+        containerFromWords(c, words);
+        return;
+    }
+
+    if (c->cardinality == c->capacity)
+    {
+        c->capacity = c->capacity ? c->capacity * 2 : 4;
+        if (c->capacity > ROARING_ARRAY_MAX)
+            c->capacity = ROARING_ARRAY_MAX;
+        c->array = realloc(c->array, c->capacity * sizeof(unsigned short));
+    }
+    memmove(&c->array[slot + 1], &c->array[slot], (c->cardinality - slot) * sizeof(unsigned short));
+    c->array[slot] = low;
+    c->cardinality++;
+}
+
+void roaringRemove(ROARING *r, unsigned int value)
+{
+    int index = roaringContainer(r, value >> 16, 0);
+    if (index < 0)
+        return;
+
+    ROARING_CONTAINER *c = &r->containers[index];
+    unsigned short low = value & 0xFFFF;
+    if (c->bits)
+    {
+        unsigned long long mask = 1ULL << (low & 63);
+        if (c->bits[low >> 6] & mask)
+        {
+            c->bits[low >> 6] &= ~mask;
+            c->cardinality--;
+        }
+        return;
+    }
+
+    int slot = containerFind(c, low);
+    if (slot < c->cardinality && c->array[slot] == low)
+    {
+        memmove(&c->array[slot], &c->array[slot + 1], (c->cardinality - slot - 1) * sizeof(unsigned short));
+        c->cardinality--;
+    }
+}
+
+int roaringContains(ROARING *r, unsigned int value)
+{
+    int index = roaringContainer(r, value >> 16, 0);
+    if (index < 0)
+        return 0;
+
+    ROARING_CONTAINER *c = &r->containers[index];
+    unsigned short low = value & 0xFFFF;
+    if (c->bits)
+        return (c->bits[low >> 6] >> (low & 63)) & 1;
+
+    int slot = containerFind(c, low);
+    return slot < c->cardinality && c->array[slot] == low;
+}
+
+long roaringCardinality(ROARING *r)
+{
+    long total = 0;
+    for (int i = 0; i < r->count; i++)
+        total += r->containers[i].cardinality;
+    return total;
+}
+
+// Combina a e b container a container: ROARING_AND, ROARING_OR ou ROARING_ANDNOT (a e nao b)
+ROARING roaringCombine(ROARING *a, ROARING *b, int operation)
+{
+    ROARING result = {0};
+    unsigned long long left[ROARING_WORDS], right[ROARING_WORDS];
+    int i = 0, j = 0;
+
+    while (i < a->count || j < b->count)
+    {
+        ROARING_CONTAINER *ca = i < a->count ? &a->containers[i] : NULL;
+        ROARING_CONTAINER *cb = j < b->count ? &b->containers[j] : NULL;
+        unsigned short key;
+
+        if (ca && cb && ca->key == cb->key)
+        {
+            key = ca->key;
+            containerToWords(ca, left);
+            containerToWords(cb, right);
+            i++;
+            j++;
+        }
+        else if (ca && (!cb || ca->key < cb->key))
+        {
+            key = ca->key;
+            containerToWords(ca, left);
+            memset(right, 0, sizeof(right));
+            i++;
+        }
+        else
+        {
+            key = cb->key;
+            memset(left, 0, sizeof(left));
+            containerToWords(cb, right);
+            j++;
+        }
+
+        for (int w = 0; w < ROARING_WORDS; w++)
+        {
+            if (operation == ROARING_AND)
+                left[w] &= right[w];
+            else if (operation == ROARING_OR)
+                left[w] |= right[w];
+            else
+                left[w] &= ~right[w];
+        }
+
+        ROARING_CONTAINER c = {0};
+        containerFromWords(&c, left);
+        if (c.cardinality == 0)
+        {
+            free(c.array);
+            continue;
+        }
+        c.key = key;
+        if (result.count == result.capacity)
+        {
+            result.capacity = result.capacity ? result.capacity * 2 : 4;
+            result.containers = realloc(result.containers, result.capacity * sizeof(ROARING_CONTAINER));
+        }
+        result.containers[result.count++] = c;
+    }
+    return result;
+}
+
+// Substitui *target por target op other
+void roaringApply(ROARING *target, ROARING *other, int operation)
+{
+    ROARING result = roaringCombine(target, other, operation);
+    freeRoaring(target);
+    *target = result;
+}
+
+void writeRoaring(ROARING *r, FILE *f)
+{
+    fwrite(&r->count, sizeof(int), 1, f);
+    for (int i = 0; i < r->count; i++)
+    {
+        ROARING_CONTAINER *c = &r->containers[i];
+        int dense = c->bits != NULL;
+        fwrite(&c->key, sizeof(unsigned short), 1, f);
+        fwrite(&c->cardinality, sizeof(int), 1, f);
+        fwrite(&dense, sizeof(int), 1, f);
+        if (dense)
+            fwrite(c->bits, sizeof(unsigned long long), ROARING_WORDS, f);
+        else
+            fwrite(c->array, sizeof(unsigned short), c->cardinality, f);
+    }
+}
+
+int readRoaring(ROARING *r, FILE *f)
+{
+    int count;
+    if (fread(&count, sizeof(int), 1, f) != 1 || count < 0 || count > 65536)
+        return 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        unsigned short key;
+        int cardinality, dense;
+        if (fread(&key, sizeof(unsigned short), 1, f) != 1 || fread(&cardinality, sizeof(int), 1, f) != 1 ||
+            fread(&dense, sizeof(int), 1, f) != 1 || cardinality < 0 || cardinality > 65536)
+            return 0;
+
+        int index = roaringContainer(r, key, 1);
+        ROARING_CONTAINER *c = &r->containers[index];
+        c->cardinality = cardinality;
+        if (dense)
+        {
+            c->bits = malloc(ROARING_WORDS * sizeof(unsigned long long));
+            if (fread(c->bits, sizeof(unsigned long long), ROARING_WORDS, f) != ROARING_WORDS)
+                return 0;
+        }
+        else
+        {
+            c->array = malloc((cardinality + 1) * sizeof(unsigned short));
+            c->capacity = cardinality;
+            if (fread(c->array, sizeof(unsigned short), cardinality, f) != (size_t)cardinality)
+                return 0;
+        }
+    }
+    return 1;
+}
+
+void freeOrderBitmaps(ORDER_BITMAPS *bitmaps)
+{
+    for (int f = 0; f < BITMAP_FIELDS; f++)
+    {
+        for (int v = 0; v < bitmaps->fields[f].count; v++)
+            freeRoaring(&bitmaps->fields[f].values[v].bitmap);
+        free(bitmaps->fields[f].values);
+    }
+    freeRoaring(&bitmaps->live);
+    memset(bitmaps, 0, sizeof(ORDER_BITMAPS));
+}
+
+void orderFieldValue(ORDER *order, int field, char *out)
+{
+    switch (field)
+    {
+    case 0:
+        snprintf(out, 32, "%c", order->product_gender);
+        break;
+    case 1:
+        snprintf(out, 32, "%s", dictionaryValue(DICT_METAL, order->metal));
+        break;
+    case 2:
+        snprintf(out, 32, "%s", dictionaryValue(DICT_GEM, order->gem));
+        break;
+    case 3:
+        snprintf(out, 32, "%s", dictionaryValue(DICT_COLOR, order->color));
+        break;
+    default:
+        snprintf(out, 32, "%lld", order->category_id);
+        break;
+    }
+}
+
+BITMAP_VALUE *bitmapValue(BITMAP_FIELD *field, const char *value, int create)
+{
+    for (int v = 0; v < field->count; v++)
+    {
+        if (strcmp(field->values[v].value, value) == 0)
+            return &field->values[v];
+    }
+    if (!create)
+        return NULL;
+
+    if (field->count == field->capacity)
+    {
+        field->capacity = field->capacity ? field->capacity * 2 : 8;
+        field->values = realloc(field->values, field->capacity * sizeof(BITMAP_VALUE));
+    }
+    BITMAP_VALUE *entry = &field->values[field->count++];
+    memset(entry, 0, sizeof(BITMAP_VALUE));
+    snprintf(entry->value, sizeof(entry->value), "%s", value);
+    return entry;
+}
+
+void orderBitmapsAdd(ORDER_BITMAPS *bitmaps, ORDER *order, unsigned int ordinal)
+{
+    char value[32];
+    for (int f = 0; f < BITMAP_FIELDS; f++)
+    {
+        orderFieldValue(order, f, value);
+        roaringAdd(&bitmapValue(&bitmaps->fields[f], value, 1)->bitmap, ordinal);
+    }
+    roaringAdd(&bitmaps->live, ordinal);
+    bitmaps->dirty = 1;
+}
+
+void saveOrderBitmaps(ORDER_BITMAPS *bitmaps)
+{
+    FILE *f = openFile("../data/orderBitmaps.rbm", "wb");
+    if (!f)
+        return;
+
+    fwrite(&bitmaps->mainCount, sizeof(long), 1, f);
+    fwrite(&bitmaps->overflowCount, sizeof(long), 1, f);
+    writeRoaring(&bitmaps->live, f);
+    for (int field = 0; field < BITMAP_FIELDS; field++)
+    {
+        fwrite(&bitmaps->fields[field].count, sizeof(int), 1, f);
+        for (int v = 0; v < bitmaps->fields[field].count; v++)
+        {
+            fwrite(bitmaps->fields[field].values[v].value, sizeof(char), 32, f);
+            writeRoaring(&bitmaps->fields[field].values[v].bitmap, f);
+        }
+    }
+    fclose(f);
+    bitmaps->dirty = 0;
+}
+
+// Ordem inserida no registro record do arquivo principal, que passou a ter mainRecords registros
+void orderBitmapsInsert(ORDER *order, long record, long mainRecords)
+{
+    orderBitmapsAdd(&orderBitmaps, order, record);
+    orderBitmaps.mainCount = mainRecords;
+}
+
+void orderBitmapsInsertOverflow(ORDER *order, long overflowOffset)
+{
+    orderBitmapsAdd(&orderBitmaps, order, ROARING_OVERFLOW_BASE + overflowOffset / sizeof(OVERFLOW_RECORD));
+    orderBitmaps.overflowCount++;
+}
+
+// A ordem mudou de slot dentro da pagina (insercao deslocou o resto da pagina)
+void orderBitmapsMove(ORDER *order, unsigned int from, unsigned int to)
+{
+    char value[32];
+    for (int f = 0; f < BITMAP_FIELDS; f++)
+    {
+        orderFieldValue(order, f, value);
+        BITMAP_VALUE *entry = bitmapValue(&orderBitmaps.fields[f], value, 0);
+        if (entry && roaringContains(&entry->bitmap, from))
+        {
+            roaringRemove(&entry->bitmap, from);
+            roaringAdd(&entry->bitmap, to);
+        }
+    }
+    if (roaringContains(&orderBitmaps.live, from))
+    {
+        roaringRemove(&orderBitmaps.live, from);
+        roaringAdd(&orderBitmaps.live, to);
+    }
+    orderBitmaps.dirty = 1;
+}
+
+void orderBitmapsRemove(unsigned int ordinal)
+{
+    roaringRemove(&orderBitmaps.live, ordinal);
+    orderBitmaps.dirty = 1;
+}
+
+// ------------------------------ Armazenamento colunar (--columnar) ------------------------------
+// Copia de status, data, product_id, quantity e preco (centavos) de cada registro do arquivo principal.
+// As agregacoes leem so as colunas que usam (17 ou 13 bytes por registro em vez de 56).
+
+const char *columnPaths[COLUMN_COUNT] = {"../data/orderHistory.status.col", "../data/orderHistory.date.col",
+                                         "../data/orderHistory.product.col", "../data/orderHistory.quantity.col",
+                                         "../data/orderHistory.price.col"};
+const size_t columnWidths[COLUMN_COUNT] = {sizeof(char), sizeof(long long), sizeof(long long), sizeof(int), sizeof(int)};
+
+void columnValue(ORDER *order, int column, char *out)
+{
+    switch (column)
+    {
+    case COLUMN_STATUS:
+        *out = !isOrderRemoved(order);
+        break;
+    case COLUMN_DATE:
+    {
+        long long date = isOrderFree(order) ? -1 : order->date;
+        memcpy(out, &date, sizeof(long long));
+        break;
+    }
+    case COLUMN_PRODUCT:
+        memcpy(out, &order->product_id, sizeof(long long));
+        break;
+    case COLUMN_QUANTITY:
+        memcpy(out, &order->quantity, sizeof(int));
+        break;
+    default:
+        memcpy(out, &order->price_cents, sizeof(int));
+        break;
+    }
+}
+
+void closeColumnStore(COLUMN_STORE *store)
+{
+    for (int c = 0; c < COLUMN_COUNT; c++)
+    {
+        if (store->files[c])
+            fclose(store->files[c]);
+        store->files[c] = NULL;
+    }
+    store->isOpen = 0;
+}
+
+// truncate = 1 recomeca as colunas vazias (merge e reconstrucao)
+int openColumnStore(COLUMN_STORE *store, int truncate)
+{
+    closeColumnStore(store);
+    for (int c = 0; c < COLUMN_COUNT; c++)
+    {
+        store->files[c] = truncate ? NULL : fopen(columnPaths[c], "rb+");
+        if (!store->files[c])
+            store->files[c] = openFile(columnPaths[c], "wb+");
+        if (!store->files[c])
+        {
+            closeColumnStore(store);
+            return 0;
+        }
+    }
+    store->isOpen = 1;
+    return 1;
+}
+
+// Sem o modo colunar as colunas deixariam de acompanhar os dados: apaga as que existirem
+void invalidateColumns(COLUMN_STORE *store)
+{
+    if (store->isOpen || store->invalidated)
+        return;
+    for (int c = 0; c < COLUMN_COUNT; c++)
+        remove(columnPaths[c]);
+    store->invalidated = 1;
+}
+
+// Espelha nas colunas os registros gravados em orderHistory.dat a partir de firstRecord
+void writeColumns(COLUMN_STORE *store, long firstRecord, ORDER *records, long count)
+{
+    if (!store->isOpen)
+    {
+        invalidateColumns(store);
+        return;
+    }
+    if (count <= 0)
+        return;
+
+    char *values = malloc(count * sizeof(long long));
+    for (int c = 0; c < COLUMN_COUNT; c++)
+    {
+        for (long i = 0; i < count; i++)
+            columnValue(&records[i], c, values + i * columnWidths[c]);
+        fseek(store->files[c], firstRecord * columnWidths[c], SEEK_SET);
+        fwrite(values, columnWidths[c], count, store->files[c]);
+        fflush(store->files[c]);
+    }
+    free(values);
+}
+
+long readColumn(COLUMN_STORE *store, int column, long firstRecord, long count, void *out)
+{
+    fseek(store->files[column], firstRecord * columnWidths[column], SEEK_SET);
+    return fread(out, columnWidths[column], count, store->files[column]);
+}
+
+// ------------------------------ Paginas do arquivo de ordens ------------------------------
+// Cada bloco do indice e uma pagina de indexGap slots. O merge preenche PAGE_FILL_PERCENT deles e
+// deixa o resto livre no fim da pagina; a insercao ocupa um slot livre da pagina certa.
+// Nao ha divisao de pagina: o arquivo precisa continuar fisicamente ordenado (merge, cursor,
+// colunas e bitmaps dependem da posicao), entao so a ultima pagina ganha uma vizinha nova.
+// Uma pagina do meio que enche (pagina quente) volta a mandar as insercoes para o overflow
+// ate a proxima carga, que redistribui os registros.
+
+int pageFill(int indexGap)
+{
+    int fill = indexGap * PAGE_FILL_PERCENT / 100;
+    return fill < 1 ? 1 : fill;
+}
+
+// Slot livre: so a chave, repetida da ultima ordem da pagina, para a busca binaria continuar valida
+void makeFreeSlot(ORDER *slot, long long key)
+{
+    memset(slot, 0, sizeof(ORDER));
+    slot->status = FREE_FLAG;
+    slot->date = -1;
+    slot->order_id = key;
+}
+
+// Grava uma pagina nova em position: a ordem no primeiro slot e o resto livre
+void writeNewPage(FILE *orderHistory, long position, ORDER *order, int indexGap)
+{
+    ORDER *page = malloc(indexGap * sizeof(ORDER));
+    page[0] = *order;
+    for (int i = 1; i < indexGap; i++)
+        makeFreeSlot(&page[i], order->order_id);
+
+    fseek(orderHistory, position, SEEK_SET);
+    fwrite(page, sizeof(ORDER), indexGap, orderHistory);
+    fflush(orderHistory);
+    writeColumns(&columnStore, position / sizeof(ORDER), page, indexGap);
+    free(page);
+}
+
+// Intercala os leitores gravando o arquivo de ordens e seu indice (ordens removidas sao descartadas)
+long mergeOrderReaders(RUN_READER *readers, int numReaders, FILE *orderHistory, FILE *orderIndex, int indexGap)
+{
+    LOSER_TREE tree;
+    initLoserTree(&tree, readers, numReaders, offsetof(ORDER, order_id));
+
+    const int WRITE_BUFFER_SIZE = 5000;
+    ORDER *writeBuffer = malloc(WRITE_BUFFER_SIZE * sizeof(ORDER));
+    int writeCount = 0;
+    long totalWritten = 0;
+    long slot = 0; // Posicao fisica, contando os slots livres das paginas
+    int pageUsed = 0;
+    int fill = pageFill(indexGap);
+    long long lastKey = 0;
+    int indexCount = 0;
+    ORDER *current;
+
+    PLA_BUILDER plaBuilder;
+    if (config.learnedIndex)
+        initPlaBuilder(&plaBuilder, &learnedIndex);
+    initBloomFilter(&orderBloom, indexGap);
+    freeProductIndex(&productIndex);
+    initZoneMaps(&orderZones);
+    freeOrderBitmaps(&orderBitmaps);
+    if (config.columnar)
+        openColumnStore(&columnStore, 1);
+    long flushed = 0;
+
+    while ((current = loserTreeTop(&tree)) != NULL)
+    {
+        if (isOrderRemoved(current))
+        {
+            loserTreeAdvance(&tree);
+            continue;
+        }
+
+        // Pagina com o preenchimento alvo: completa com slots livres e comeca outra. Itens da
+        // mesma ordem ficam na mesma pagina enquanto houver slot, para a busca achar o primeiro.
+        while (pageUsed >= fill && current->order_id != lastKey && slot % indexGap != 0)
+        {
+            makeFreeSlot(&writeBuffer[writeCount++], lastKey);
+            slot++;
+            if (writeCount >= WRITE_BUFFER_SIZE)
+            {
+                fwrite(writeBuffer, sizeof(ORDER), writeCount, orderHistory);
+                writeColumns(&columnStore, flushed, writeBuffer, writeCount);
+                flushed += writeCount;
+                writeCount = 0;
+            }
+        }
+        if (slot % indexGap == 0)
+        {
+            INDEX indexEntry = {current->order_id, slot * sizeof(ORDER)};
+            fwrite(&indexEntry, sizeof(INDEX), 1, orderIndex);
+            indexCount++;
+            pageUsed = 0;
+        }
+
+        writeBuffer[writeCount++] = *current;
+        if (config.learnedIndex)
+            plaBuilderAdd(&plaBuilder, current->order_id, slot);
+        bloomAdd(&orderBloom, slot / indexGap, current->order_id);
+        addProductPosting(&productIndex, current->product_id, slot);
+        zoneAdd(&orderZones, slot / indexGap, current);
+        orderBitmapsAdd(&orderBitmaps, current, slot);
+
+        lastKey = current->order_id;
+        pageUsed++;
+        slot++;
+        totalWritten++;
+
+        if (writeCount >= WRITE_BUFFER_SIZE)
+        {
+            fwrite(writeBuffer, sizeof(ORDER), writeCount, orderHistory);
+            writeColumns(&columnStore, flushed, writeBuffer, writeCount);
+            flushed += writeCount;
+            writeCount = 0;
+        }
+
+        loserTreeAdvance(&tree);
+    }
+
+    // Ultima pagina tambem fica com o tamanho completo
+    while (slot % indexGap != 0)
+    {
+        makeFreeSlot(&writeBuffer[writeCount++], lastKey);
+        slot++;
+        if (writeCount >= WRITE_BUFFER_SIZE)
+        {
+            fwrite(writeBuffer, sizeof(ORDER), writeCount, orderHistory);
+            writeColumns(&columnStore, flushed, writeBuffer, writeCount);
+            flushed += writeCount;
+            writeCount = 0;
+        }
+    }
+
+    if (writeCount > 0)
+    {
+        fwrite(writeBuffer, sizeof(ORDER), writeCount, orderHistory);
+        writeColumns(&columnStore, flushed, writeBuffer, writeCount);
+        flushed += writeCount;
+    }
+
+    freeLoserTree(&tree);
+    free(writeBuffer);
+    fflush(orderHistory);
+    fflush(orderIndex);
+
+    // Sem --learned-index o .pla antigo nao descreve mais o arquivo: e apagado
+    if (config.learnedIndex)
+    {
+        plaBuilderFinish(&plaBuilder);
+        saveLearnedIndex(&learnedIndex, orderHistory);
+    }
+    else
+        remove("../data/orderIndex.pla");
+    saveBloomFilter(&orderBloom, indexCount);
+    finishProductIndex(&productIndex, slot);
+    saveZoneMaps(&orderZones, indexCount);
+    orderBitmaps.mainCount = slot;
+    saveOrderBitmaps(&orderBitmaps);
+
+    printf("Orders: %ld registros, %d indices\n", totalWritten, indexCount);
+    return totalWritten;
+}
+
+int mergeOrderRuns(int numRuns, FILE *orderHistory, FILE *orderIndex, int indexGap)
+{
+    numRuns = reduceRuns("order", numRuns, sizeof(ORDER), offsetof(ORDER, order_id), 0);
+
+    RUN_READER *readers = openRuns("order", 0, numRuns, sizeof(ORDER));
+    long totalWritten = mergeOrderReaders(readers, numRuns, orderHistory, orderIndex, indexGap);
+    closeRuns("order", readers, 0, numRuns);
+    free(readers);
+
+    return totalWritten;
+}
+
+// Intercala os leitores mantendo so o primeiro registro de cada product_id
+long mergeJewelryReaders(RUN_READER *readers, int numReaders, FILE *jewelryRegister, FILE *jewelryIndex, int indexGap)
+{
+    LOSER_TREE tree;
+    initLoserTree(&tree, readers, numReaders, offsetof(JEWELRY, product_id));
+
+    const int WRITE_BUFFER_SIZE = 5000;
+    JEWELRY *writeBuffer = malloc(WRITE_BUFFER_SIZE * sizeof(JEWELRY));
+    int writeCount = 0;
+    long totalWritten = 0;
+    int indexCount = 0;
+    long long lastProductId = -1;
+    JEWELRY *current;
+
+    while ((current = loserTreeTop(&tree)) != NULL)
+    {
+        if (current->product_id != lastProductId)
+        {
+            writeBuffer[writeCount++] = *current;
+            lastProductId = current->product_id;
+
+            if (totalWritten % indexGap == 0)
+            {
+                INDEX indexEntry = {current->product_id, totalWritten * sizeof(JEWELRY)};
+                fwrite(&indexEntry, sizeof(INDEX), 1, jewelryIndex);
+                indexCount++;
+            }
+
+            totalWritten++;
+
+            if (writeCount >= WRITE_BUFFER_SIZE)
+            {
+                fwrite(writeBuffer, sizeof(JEWELRY), writeCount, jewelryRegister);
+                writeCount = 0;
+            }
+        }
+
+        loserTreeAdvance(&tree);
+    }
+
+    if (writeCount > 0)
+    {
+        fwrite(writeBuffer, sizeof(JEWELRY), writeCount, jewelryRegister);
+    }
+
+    freeLoserTree(&tree);
+    free(writeBuffer);
+    fflush(jewelryRegister);
+    fflush(jewelryIndex);
+
+    printf("Jewelry: %ld registros unicos, %d indices\n\n", totalWritten, indexCount);
+    return totalWritten;
+}
+
+int mergeJewelryRuns(int numRuns, FILE *jewelryRegister, FILE *jewelryIndex, int indexGap)
+{
+    numRuns = reduceRuns("jewelry", numRuns, sizeof(JEWELRY), offsetof(JEWELRY, product_id), 0);
+
+    RUN_READER *readers = openRuns("jewelry", 0, numRuns, sizeof(JEWELRY));
+    long totalWritten = mergeJewelryReaders(readers, numRuns, jewelryRegister, jewelryIndex, indexGap);
+    closeRuns("jewelry", readers, 0, numRuns);
+    free(readers);
+
+    return totalWritten;
+}
+
+int processCategoryData(FILE *jewelryRegister, FILE *categoryRegister,
+                        FILE *categoryIndex, int indexGap)
+{
+    FILE *tempCat = fopen("../data/temp_category_run_0.dat", "rb");
+    if (!tempCat)
+    {
+        printf("Erro ao abrir arquivo temporario de categorias\n");
+        return 0;
+    }
+
+    fseek(tempCat, 0, SEEK_END);
+    long catCount = ftell(tempCat) / sizeof(CATEGORY);
+    fseek(tempCat, 0, SEEK_SET);
+
+    CATEGORY *categories = malloc(catCount * sizeof(CATEGORY));
+    fread(categories, sizeof(CATEGORY), catCount, tempCat);
+    fclose(tempCat);
+    remove("../data/temp_category_run_0.dat");
+
+    fseek(jewelryRegister, 0, SEEK_END);
+    long jewelryCount = ftell(jewelryRegister) / sizeof(JEWELRY);
+    fseek(jewelryRegister, 0, SEEK_SET);
+
+    JEWELRY jewelry;
+    for (long i = 0; i < jewelryCount; i++)
+    {
+        if (fread(&jewelry, sizeof(JEWELRY), 1, jewelryRegister) != 1)
+            break;
+
+        for (int j = 0; j < catCount; j++)
+        {
+            if (categories[j].category_id == jewelry.category_id)
+            {
+                categories[j].product_count++;
+                break;
+            }
+        }
+
+        if ((i + 1) % 1000 == 0)
+        {
+            fflush(stdout);
+        }
+    }
+
+    printf("\n");
+
+    for (int i = 0; i < catCount; i++)
+    {
+        long pos = i * sizeof(CATEGORY);
+        fwrite(&categories[i], sizeof(CATEGORY), 1, categoryRegister);
+
+        if (i % indexGap == 0)
+        {
+            INDEX indexEntry = {categories[i].category_id, pos};
+            fwrite(&indexEntry, sizeof(INDEX), 1, categoryIndex);
+        }
+    }
+
+    fflush(categoryRegister);
+    fflush(categoryIndex);
+
+    printf("Categories: %ld registros\n\n", catCount);
+
+    free(categories);
+    return catCount;
+}
+
+// ------------------------------ Indice B+tree ------------------------------
+// Os .idx continuam sendo a lista plana de entradas {id, posicao}; o .bpt ao lado organiza
+// essas entradas em paginas de BPT_PAGE_SIZE. Os nos internos ficam fixados em memoria,
+// entao uma busca custa uma unica leitura de pagina (a folha).
+
+long bptPageOffset(long page)
+{
+    return page * (long)sizeof(BPT_PAGE);
+}
+
+void bptReadPage(BPTREE *tree, long page, BPT_PAGE *out)
+{
+    fseek(tree->file, bptPageOffset(page), SEEK_SET);
+    if (fread(out, sizeof(BPT_PAGE), 1, tree->file) != 1)
+        memset(out, 0, sizeof(BPT_PAGE));
+}
+
+void bptWritePage(BPTREE *tree, long page, BPT_PAGE *node)
+{
+    fseek(tree->file, bptPageOffset(page), SEEK_SET);
+    fwrite(node, sizeof(BPT_PAGE), 1, tree->file);
+}
+
+void bptWriteMeta(BPTREE *tree)
+{
+    BPT_PAGE page = {0};
+    memcpy(&page, &tree->meta, sizeof(BPT_META));
+    bptWritePage(tree, 0, &page);
+    fflush(tree->file);
+}
+
+// Ultima posicao i com keys[i] <= key (0 se key for menor que todas)
+int bptFindSlot(BPT_PAGE *node, long long key)
+{
+    int left = 0, right = node->count - 1, slot = 0;
+
+    while (left <= right)
+    {
+        int middle = left + (right - left) / 2;
+        if (node->keys[middle] <= key)
+        {
+            slot = middle;
+            left = middle + 1;
+        }
+        else
+        {
+            right = middle - 1;
+        }
+    }
+    return slot;
+}
+
+void bptFreeCache(BPTREE *tree)
+{
+    for (long i = 0; i < tree->cacheSize; i++)
+        free(tree->cache[i]);
+    free(tree->cache);
+    tree->cache = NULL;
+    tree->cacheSize = 0;
+}
+
+void bptCachePage(BPTREE *tree, long page, BPT_PAGE *node)
+{
+    if (page >= tree->cacheSize)
+    {
+        long newSize = tree->cacheSize ? tree->cacheSize : 16;
+        while (newSize <= page)
+            newSize *= 2;
+        tree->cache = realloc(tree->cache, newSize * sizeof(BPT_PAGE *));
+        memset(tree->cache + tree->cacheSize, 0, (newSize - tree->cacheSize) * sizeof(BPT_PAGE *));
+        tree->cacheSize = newSize;
+    }
+
+    if (!tree->cache[page])
+        tree->cache[page] = malloc(sizeof(BPT_PAGE));
+    *tree->cache[page] = *node;
+}
+
+// Carrega em memoria todos os nos acima das folhas
+void bptPinLevels(BPTREE *tree, long page, int level)
+{
+    if (level >= tree->meta.height)
+        return;
+
+    BPT_PAGE node;
+    bptReadPage(tree, page, &node);
+    bptCachePage(tree, page, &node);
+
+    for (int i = 0; i < node.count; i++)
+        bptPinLevels(tree, node.values[i], level + 1);
+}
+
+// Reescreve o .bpt a partir do indice plano: folhas cheias em sequencia, depois cada
+// nivel interno aponta para o anterior ate sobrar uma pagina (a raiz)
+int bptBulkLoad(BPTREE *tree, FILE *flatIndex)
+{
+    fflush(flatIndex);
+    fseek(flatIndex, 0, SEEK_END);
+    long total = ftell(flatIndex) / sizeof(INDEX);
+    fseek(flatIndex, 0, SEEK_SET);
+
+    bptFreeCache(tree);
+    fflush(tree->file);
+    ftruncate(fileno(tree->file), 0);
+
+    tree->meta.magic = BPT_MAGIC;
+    tree->meta.height = 0;
+    tree->meta.root = -1;
+    tree->meta.pageCount = 1;
+    tree->meta.entryCount = 0;
+
+    long levelCount = (total + BPT_PAGE_ENTRIES - 1) / BPT_PAGE_ENTRIES;
+    long long *levelKeys = malloc((levelCount + 1) * sizeof(long long));
+    long *levelPages = malloc((levelCount + 1) * sizeof(long));
+
+    BPT_PAGE node;
+    INDEX entry;
+    long count = 0;
+    memset(&node, 0, sizeof(BPT_PAGE));
+    node.leaf = 1;
+
+    for (long i = 0; i < total; i++)
+    {
+        if (fread(&entry, sizeof(INDEX), 1, flatIndex) != 1)
+            break;
+
+        node.keys[node.count] = entry.id;
+        node.values[node.count] = entry.position;
+        node.count++;
+        tree->meta.entryCount++;
+
+        if (node.count == (int)BPT_PAGE_ENTRIES || i == total - 1)
+        {
+            long page = tree->meta.pageCount++;
+            node.next = (i == total - 1) ? -1 : page + 1;
+            bptWritePage(tree, page, &node);
+
+            levelKeys[count] = node.keys[0];
+            levelPages[count] = page;
+            count++;
+
+            memset(&node, 0, sizeof(BPT_PAGE));
+            node.leaf = 1;
+        }
+    }
+
+    if (count > 0)
+        tree->meta.height = 1;
+
+    while (count > 1)
+    {
+        long parents = 0;
+        for (long i = 0; i < count; i += BPT_PAGE_ENTRIES)
+        {
+            memset(&node, 0, sizeof(BPT_PAGE));
+            node.next = -1;
+            for (long j = i; j < count && j < i + (long)BPT_PAGE_ENTRIES; j++)
+            {
+                node.keys[node.count] = levelKeys[j];
+                node.values[node.count] = levelPages[j];
+                node.count++;
+            }
+
+            long page = tree->meta.pageCount++;
+            bptWritePage(tree, page, &node);
+            levelKeys[parents] = node.keys[0];
+            levelPages[parents] = page;
+            parents++;
+        }
+        count = parents;
+        tree->meta.height++;
+    }
+
+    if (count == 1)
+        tree->meta.root = levelPages[0];
+
+    free(levelKeys);
+    free(levelPages);
+
+    bptWriteMeta(tree);
+    if (tree->meta.height > 0)
+        bptPinLevels(tree, tree->meta.root, 1);
+
+    return tree->meta.entryCount;
+}
+
+// Abre o .bpt; se nao existir ou nao corresponder ao indice plano, reconstroi
+int bptOpen(BPTREE *tree, const char *path, FILE *flatIndex)
+{
+    memset(tree, 0, sizeof(BPTREE));
+    tree->file = fopen(path, "rb+");
+    if (!tree->file)
+        tree->file = openFile(path, "wb+");
+    if (!tree->file)
+        return 0;
+
+    fseek(flatIndex, 0, SEEK_END);
+    long flatEntries = ftell(flatIndex) / sizeof(INDEX);
+
+    BPT_PAGE page;
+    bptReadPage(tree, 0, &page);
+    memcpy(&tree->meta, &page, sizeof(BPT_META));
+
+    if (tree->meta.magic != BPT_MAGIC || tree->meta.entryCount != flatEntries)
+        bptBulkLoad(tree, flatIndex);
+    else if (tree->meta.height > 0)
+        bptPinLevels(tree, tree->meta.root, 1);
+
+    return 1;
+}
+
+void bptClose(BPTREE *tree)
+{
+    if (tree->file)
+        fclose(tree->file);
+    bptFreeCache(tree);
+    tree->file = NULL;
+}
+
+// Cria o .bpt de um indice recem-gravado pelo merge
+void bptCreate(const char *path, FILE *flatIndex)
+{
+    BPTREE tree = {0};
+    tree.file = openFile(path, "wb+");
+    if (!tree.file)
+        return;
+
+    bptBulkLoad(&tree, flatIndex);
+    printf("  %s: %ld entradas, altura %d\n", path, tree.meta.entryCount, tree.meta.height);
+    bptClose(&tree);
+}
+
+// Posicao do bloco que pode conter key (ultima entrada com id <= key); -1 se vazio
+long bptLookup(BPTREE *tree, long long key)
+{
+    if (tree->meta.height == 0)
+        return -1;
+
+    long page = tree->meta.root;
+    for (int level = 1; level < tree->meta.height; level++)
+    {
+        BPT_PAGE *node = tree->cache[page];
+        page = node->values[bptFindSlot(node, key)];
+    }
+
+    BPT_PAGE leaf;
+    bptReadPage(tree, page, &leaf);
+    if (leaf.count == 0)
+        return -1;
+
+    return leaf.values[bptFindSlot(&leaf, key)];
+}
+
+// Insere {key, value}; folhas e nos internos cheios sao divididos ao meio,
+// a metade direita vai para uma pagina nova no fim do arquivo
+int bptInsert(BPTREE *tree, long long key, long value)
+{
+    BPT_PAGE node;
+
+    if (tree->meta.height == 0)
+    {
+        memset(&node, 0, sizeof(BPT_PAGE));
+        node.leaf = 1;
+        node.next = -1;
+        node.count = 1;
+        node.keys[0] = key;
+        node.values[0] = value;
+
+        tree->meta.root = tree->meta.pageCount++;
+        tree->meta.height = 1;
+        tree->meta.entryCount = 1;
+        bptWritePage(tree, tree->meta.root, &node);
+        bptWriteMeta(tree);
+        return 1;
+    }
+
+    long path[BPT_MAX_HEIGHT];
+    int slots[BPT_MAX_HEIGHT];
+    long page = tree->meta.root;
+    for (int level = 0; level < tree->meta.height - 1; level++)
+    {
+        BPT_PAGE *internal = tree->cache[page];
+
+        // keys[0] continua sendo um limite inferior da subarvore
+        if (key < internal->keys[0])
+        {
+            internal->keys[0] = key;
+            bptWritePage(tree, page, internal);
+        }
+
+        path[level] = page;
+        slots[level] = bptFindSlot(internal, key);
+        page = internal->values[slots[level]];
+    }
+
+    bptReadPage(tree, page, &node);
+    long long splitKey = 0;
+    long splitPage = -1;
+
+    for (int level = tree->meta.height - 1; level >= 0; level--)
+    {
+        int pos = 0;
+        if (level < tree->meta.height - 1)
+        {
+            // A pagina nova entra logo depois da filha que foi dividida
+            page = path[level];
+            node = *tree->cache[page];
+            key = splitKey;
+            value = splitPage;
+            pos = slots[level] + 1;
+        }
+        else
+        {
+            while (pos < node.count && node.keys[pos] <= key)
+                pos++;
+        }
+
+        memmove(&node.keys[pos + 1], &node.keys[pos], (node.count - pos) * sizeof(long long));
+        memmove(&node.values[pos + 1], &node.values[pos], (node.count - pos) * sizeof(long));
+        node.keys[pos] = key;
+        node.values[pos] = value;
+        node.count++;
+
+        if (node.count <= (int)BPT_PAGE_ENTRIES)
+        {
+            bptWritePage(tree, page, &node);
+            if (!node.leaf)
+                bptCachePage(tree, page, &node);
+            splitPage = -1;
+            break;
+        }
+
+        BPT_PAGE right;
+        memset(&right, 0, sizeof(BPT_PAGE));
+        int half = node.count / 2;
+
+        right.leaf = node.leaf;
+        right.count = node.count - half;
+        memcpy(right.keys, &node.keys[half], right.count * sizeof(long long));
+        memcpy(right.values, &node.values[half], right.count * sizeof(long));
+        node.count = half;
+
+        splitPage = tree->meta.pageCount++;
+        splitKey = right.keys[0];
+        right.next = node.leaf ? node.next : -1;
+        if (node.leaf)
+            node.next = splitPage;
+
+        bptWritePage(tree, page, &node);
+        bptWritePage(tree, splitPage, &right);
+        if (!node.leaf)
+        {
+            bptCachePage(tree, page, &node);
+            bptCachePage(tree, splitPage, &right);
+        }
+    }
+
+    // A raiz foi dividida: nova raiz com as duas metades
+    if (splitPage >= 0 && tree->meta.height < BPT_MAX_HEIGHT)
+    {
+        BPT_PAGE root;
+        memset(&root, 0, sizeof(BPT_PAGE));
+        root.next = -1;
+        root.count = 2;
+        root.keys[0] = node.keys[0];
+        root.values[0] = tree->meta.root;
+        root.keys[1] = splitKey;
+        root.values[1] = splitPage;
+
+        tree->meta.root = tree->meta.pageCount++;
+        tree->meta.height++;
+        bptWritePage(tree, tree->meta.root, &root);
+        bptCachePage(tree, tree->meta.root, &root);
+    }
+
+    tree->meta.entryCount++;
+    bptWriteMeta(tree);
+    return 1;
+}
+
+// ------------------------------ Indices esparsos abertos ------------------------------
+// Com uma entrada a cada indexGap registros os .idx sao pequenos: ao abrir o banco cada um
+// e lido inteiro para um vetor e as buscas no indice nao fazem nenhuma chamada de sistema.
+// So um indice acima de RESIDENT_INDEX_LIMIT fica no disco, consultado pelo B+tree.
+
+// Preenche o layout de Eytzinger pela ordem simetrica da arvore implicita (filhos de k: 2k e 2k+1)
+long fillEytzinger(SPARSE_INDEX *index, long i, long k)
+{
+    if (k <= index->count)
+    {
+        i = fillEytzinger(index, i, 2 * k);
+        index->eytzKeys[k] = index->entries[i].id;
+        index->eytzPositions[k] = index->entries[i].position;
+        i++;
+        i = fillEytzinger(index, i, 2 * k + 1);
+    }
+    return i;
+}
+
+void buildEytzinger(SPARSE_INDEX *index)
+{
+    free(index->eytzKeys);
+    free(index->eytzPositions);
+
+    index->eytzKeys = malloc((index->count + 1) * sizeof(long long));
+    index->eytzPositions = malloc((index->count + 1) * sizeof(long));
+
+    fillEytzinger(index, 0, 1);
+}
+
+// Busca sem desvios: desce sempre (k = 2k + [chave <= key]) e os bits de k guardam o caminho.
+// O ultimo passo para a direita e a ultima entrada com id <= key.
+long eytzingerLookup(SPARSE_INDEX *index, long long key)
+{
+    if (index->count == 0)
+        return -1;
+
+    long k = 1;
+    while (k <= index->count)
+    {
+        // Os 8 descendentes 3 niveis abaixo de k ocupam uma linha de cache
+        PREFETCH(index->eytzKeys + 8 * k);
+        k = 2 * k + (index->eytzKeys[k] <= key);
+    }
+
+    k >>= TRAILING_ZEROS(k) + 1;
+    return k ? index->eytzPositions[k] : index->entries[0].position;
+}
+
+void loadResidentIndex(SPARSE_INDEX *index, FILE *flatIndex)
+{
+    free(index->entries);
+    free(index->eytzKeys);
+    free(index->eytzPositions);
+    index->eytzKeys = NULL;
+    index->eytzPositions = NULL;
+    index->entries = NULL;
+    index->count = 0;
+    index->capacity = 0;
+
+    fflush(flatIndex);
+    fseek(flatIndex, 0, SEEK_END);
+    long total = ftell(flatIndex) / sizeof(INDEX);
+    if (total * (long)sizeof(INDEX) > RESIDENT_INDEX_LIMIT)
+        return;
+
+    index->capacity = total + 16;
+    index->entries = malloc(index->capacity * sizeof(INDEX));
+    fseek(flatIndex, 0, SEEK_SET);
+    index->count = fread(index->entries, sizeof(INDEX), total, flatIndex);
+    buildEytzinger(index);
+}
+
+int openSparseIndex(SPARSE_INDEX *index, const char *treePath, FILE *flatIndex)
+{
+    if (!bptOpen(&index->tree, treePath, flatIndex))
+        return 0;
+
+    loadResidentIndex(index, flatIndex);
+    index->isOpen = 1;
+    return 1;
+}
+
+void closeSparseIndex(SPARSE_INDEX *index)
+{
+    bptClose(&index->tree);
+    free(index->entries);
+    free(index->eytzKeys);
+    free(index->eytzPositions);
+    memset(index, 0, sizeof(SPARSE_INDEX));
+}
+
+// Depois que o .idx foi regravado (reconstrucao, carga incremental)
+void reloadSparseIndex(SPARSE_INDEX *index, FILE *flatIndex)
+{
+    if (!index->isOpen)
+        return;
+
+    bptBulkLoad(&index->tree, flatIndex);
+    loadResidentIndex(index, flatIndex);
+}
+
+// Numero do bloco (entrada do indice) onde key deve estar; 0 se key for menor que todas, -1 se vazio
+long residentSlot(SPARSE_INDEX *index, long long key)
+{
+    if (index->count == 0)
+        return -1;
+
+    long left = 0, right = index->count - 1, slot = 0;
+    while (left <= right)
+    {
+        long middle = left + (right - left) / 2;
+        if (index->entries[middle].id <= key)
+        {
+            slot = middle;
+            left = middle + 1;
+        }
+        else
+        {
+            right = middle - 1;
+        }
+    }
+    return slot;
+}
+
+// Ultima entrada com id <= key no vetor residente, por busca binaria (referencia do benchmark)
+long residentLookup(SPARSE_INDEX *index, long long key)
+{
+    long slot = residentSlot(index, key);
+    return slot < 0 ? -1 : index->entries[slot].position;
+}
+
+// Posicao do bloco de dados onde key deve estar: vetor residente, B+tree ou, durante
+// a carga (antes de abrir os indices), busca binaria direto no .idx
+long findBlockPosition(SPARSE_INDEX *index, FILE *flatIndex, long long key)
+{
+    if (index->entries)
+        return eytzingerLookup(index, key);
+    if (index->isOpen)
+        return bptLookup(&index->tree, key);
+
+    fseek(flatIndex, 0, SEEK_END);
+    int totalEntries = ftell(flatIndex) / sizeof(INDEX);
+    if (totalEntries == 0)
+        return -1;
+
+    int left = 0, right = totalEntries - 1;
+    long position = 0;
+    INDEX current;
+
+    while (left <= right)
+    {
+        int middle = left + (right - left) / 2;
+        fseek(flatIndex, middle * sizeof(INDEX), SEEK_SET);
+        fread(&current, sizeof(INDEX), 1, flatIndex);
+
+        if (current.id <= key)
+        {
+            position = current.position;
+            left = middle + 1;
+        }
+        else
+        {
+            right = middle - 1;
+        }
+    }
+    return position;
+}
+
+// Acrescenta uma entrada no fim do .idx, do vetor residente e do B+tree
+void appendIndexEntry(SPARSE_INDEX *index, FILE *flatIndex, long long key, long position)
+{
+    INDEX entry = {key, position};
+    fseek(flatIndex, 0, SEEK_END);
+    fwrite(&entry, sizeof(INDEX), 1, flatIndex);
+    fflush(flatIndex);
+
+    if (!index->isOpen)
+        return;
+
+    if (index->entries)
+    {
+        if (index->count == index->capacity)
+        {
+            index->capacity = index->capacity * 2 + 16;
+            index->entries = realloc(index->entries, index->capacity * sizeof(INDEX));
+        }
+        index->entries[index->count++] = entry;
+        buildEytzinger(index);
+    }
+    bptInsert(&index->tree, key, position);
+}
+
+// Le o bloco inteiro (ate maxRecords registros) com um unico fread em um buffer reutilizado;
+// o ponteiro vale ate a proxima chamada
+char *readBlock(FILE *file, long position, long maxRecords, size_t recordSize, long *count)
+{
+    static char *buffer = NULL;
+    static size_t capacity = 0;
+
+    if (maxRecords * recordSize > capacity)
+    {
+        capacity = maxRecords * recordSize;
+        buffer = realloc(buffer, capacity);
+    }
+
+    fseek(file, position, SEEK_SET);
+    *count = fread(buffer, recordSize, maxRecords, file);
+    return buffer;
+}
+
+// Primeiro registro do bloco com chave >= key (o bloco esta ordenado pela chave)
+long blockLowerBound(const char *block, long count, size_t recordSize, size_t keyOffset, long long key)
+{
+    long left = 0, right = count;
+    while (left < right)
+    {
+        long middle = left + (right - left) / 2;
+        if (recordKey(block + middle * recordSize, keyOffset) < key)
+            left = middle + 1;
+        else
+            right = middle;
+    }
+    return left;
+}
+
+// ------------------------------ Busca em lote ------------------------------
+// As chaves sao ordenadas e deduplicadas; cada bloco (e sua cadeia de overflow) e lido uma vez,
+// sempre avancando no arquivo.
+
+int compareBatchProbes(const void *a, const void *b)
+{
+    const BATCH_PROBE *x = a, *y = b;
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+BATCH_PROBE *sortBatchProbes(const long long *keys, long count)
+{
+    BATCH_PROBE *probes = malloc((count + 1) * sizeof(BATCH_PROBE));
+    for (long i = 0; i < count; i++)
+    {
+        probes[i].key = keys[i];
+        probes[i].slot = i;
+    }
+    qsort(probes, count, sizeof(BATCH_PROBE), compareBatchProbes);
+    return probes;
+}
+
+// Bloco da chave; com indice residente so avanca o cursor *slot (as chaves chegam em ordem)
+long batchBlockPosition(SPARSE_INDEX *index, FILE *flatIndex, long long key, long *slot)
+{
+    if (!index->entries)
+        return findBlockPosition(index, flatIndex, key);
+    if (index->count == 0)
+        return -1;
+
+    while (*slot + 1 < index->count && index->entries[*slot + 1].id <= key)
+        (*slot)++;
+    return index->entries[*slot].position;
+}
+
+// ------------------------------ Cadeias de overflow por bloco ------------------------------
+// Cada registro de overflow aponta (nextOverflow) para o anterior do mesmo bloco; as cabecas
+// ficam em memoria. Uma busca que falha no bloco principal percorre so o overflow do seu bloco.
+
+long overflowHead(OVERFLOW_CHAINS *chains, long blockPos)
+{
+    long left = 0, right = chains->count - 1;
+    while (left <= right)
+    {
+        long middle = left + (right - left) / 2;
+        if (chains->heads[middle].blockPos == blockPos)
+            return chains->heads[middle].head;
+        if (chains->heads[middle].blockPos < blockPos)
+            left = middle + 1;
+        else
+            right = middle - 1;
+    }
+    return -1;
+}
+
+void setOverflowHead(OVERFLOW_CHAINS *chains, long blockPos, long head)
+{
+    long left = 0, right = chains->count;
+    while (left < right)
+    {
+        long middle = left + (right - left) / 2;
+        if (chains->heads[middle].blockPos < blockPos)
+            left = middle + 1;
+        else
+            right = middle;
+    }
+
+    if (left < chains->count && chains->heads[left].blockPos == blockPos)
+    {
+        chains->heads[left].head = head;
+        return;
+    }
+
+    if (chains->count == chains->capacity)
+    {
+        chains->capacity = chains->capacity * 2 + 16;
+        chains->heads = realloc(chains->heads, chains->capacity * sizeof(OVERFLOW_HEAD));
+    }
+    memmove(&chains->heads[left + 1], &chains->heads[left], (chains->count - left) * sizeof(OVERFLOW_HEAD));
+    chains->heads[left].blockPos = blockPos;
+    chains->heads[left].head = head;
+    chains->count++;
+}
+
+// Bloco de uma ordem pelo indice atual (o primeiro bloco quando o indice esta vazio)
+long orderBlockOf(FILE *orderIndex, long long order_id)
+{
+    long blockPos = findBlockPosition(&orderSparse, orderIndex, order_id);
+    return blockPos < 0 ? 0 : blockPos;
+}
+
+// Refaz blocos e ligacoes de todo o overflow; necessario quando as posicoes dos blocos mudam
+void relinkOverflowChains(OVERFLOW_CHAINS *chains, FILE *orderIndex)
+{
+    chains->count = 0;
+
+    fflush(chains->file);
+    fseek(chains->file, 0, SEEK_END);
+    long total = ftell(chains->file) / sizeof(OVERFLOW_RECORD);
+    if (total == 0)
+        return;
+
+    OVERFLOW_RECORD *records = malloc(total * sizeof(OVERFLOW_RECORD));
+    fseek(chains->file, 0, SEEK_SET);
+    total = fread(records, sizeof(OVERFLOW_RECORD), total, chains->file);
+
+    for (long i = 0; i < total; i++)
+    {
+        long blockPos = orderBlockOf(orderIndex, records[i].record.order_id);
+        records[i].originalBlockPos = blockPos;
+        records[i].nextOverflow = overflowHead(chains, blockPos);
+        setOverflowHead(chains, blockPos, i * sizeof(OVERFLOW_RECORD));
+    }
+
+    fseek(chains->file, 0, SEEK_SET);
+    fwrite(records, sizeof(OVERFLOW_RECORD), total, chains->file);
+    fflush(chains->file);
+    free(records);
+}
+
+void openOverflowChains(OVERFLOW_CHAINS *chains, FILE *orderOverflow, FILE *orderIndex)
+{
+    chains->file = orderOverflow;
+    chains->isOpen = 1;
+    relinkOverflowChains(chains, orderIndex);
+}
+
+void closeOverflowChains(OVERFLOW_CHAINS *chains)
+{
+    free(chains->heads);
+    memset(chains, 0, sizeof(OVERFLOW_CHAINS));
+}
+
+// Percorre a cadeia do bloco; devolve o offset do registro ativo com order_id ou -1
+long findOverflowRecord(FILE *orderOverflow, long blockPos, long long order_id, OVERFLOW_RECORD *out)
+{
+    long offset = overflowHead(&overflowChains, blockPos);
+    while (offset >= 0)
+    {
+        fseek(orderOverflow, offset, SEEK_SET);
+        if (fread(out, sizeof(OVERFLOW_RECORD), 1, orderOverflow) != 1)
+            break;
+
+        if (out->record.order_id == order_id && !isOrderRemoved(&out->record))
+            return offset;
+        offset = out->nextOverflow;
+    }
+    return -1;
+}
+
+// Refaz os filtros a partir dos dados: arquivo principal e cadeias de overflow
+void rebuildOrderBloom(FILE *orderHistory, int indexGap)
+{
+    initBloomFilter(&orderBloom, indexGap);
+    if (orderSparse.count == 0)
+        return;
+    bloomEnsureBlocks(&orderBloom, orderSparse.count);
+
+    RUN_READER reader;
+    fflush(orderHistory);
+    if (openRunReader(&reader, "../data/orderHistory.dat", sizeof(ORDER)))
+    {
+        ORDER *order;
+        while ((order = runReaderCurrent(&reader)) != NULL)
+        {
+            if (!isOrderRemoved(order))
+                bloomAdd(&orderBloom, residentSlot(&orderSparse, order->order_id), order->order_id);
+            runReaderAdvance(&reader);
+        }
+        closeRunReader(&reader);
+    }
+
+    if (overflowChains.isOpen)
+    {
+        OVERFLOW_RECORD overflow;
+        fseek(overflowChains.file, 0, SEEK_SET);
+        while (fread(&overflow, sizeof(OVERFLOW_RECORD), 1, overflowChains.file) == 1)
+        {
+            if (!isOrderRemoved(&overflow.record))
+                bloomAdd(&orderBloom, residentSlot(&orderSparse, overflow.record.order_id), overflow.record.order_id);
+        }
+    }
+
+    saveBloomFilter(&orderBloom, orderSparse.count);
+}
+
+// Insercao: regrava so as palavras do bloco alterado (e os blocos que o indice ganhou desde a
+// ultima gravacao). O arquivo inteiro so e regravado no merge e na reconstrucao.
+void saveBloomBlock(BLOOM_FILTER *bloom, long slot, long usedBlocks)
+{
+    bloomEnsureBlocks(bloom, usedBlocks);
+    long header[2] = {usedBlocks, bloom->wordsPerBlock};
+    if (!saveFileBlocks("../data/orderBloom.bf", header, sizeof(header), bloom->bits,
+                        bloom->wordsPerBlock * sizeof(unsigned long long), slot, usedBlocks))
+        saveBloomFilter(bloom, usedBlocks);
+}
+
+// Carrega orderBloom.bf (gravado no merge); se nao bater com o indice, refaz pelos dados
+void loadOrderBloom(FILE *orderHistory, int indexGap)
+{
+    initBloomFilter(&orderBloom, indexGap);
+    if (!orderSparse.entries)
+        return; // Os blocos sao numerados pelo indice residente
+
+    long blocks = 0, wordsPerBlock = 0;
+    int ok = 0;
+    FILE *f = fopen("../data/orderBloom.bf", "rb");
+    if (f)
+    {
+        ok = fread(&blocks, sizeof(long), 1, f) == 1 &&
+             fread(&wordsPerBlock, sizeof(long), 1, f) == 1 &&
+             blocks == orderSparse.count && wordsPerBlock == orderBloom.wordsPerBlock;
+        if (ok)
+        {
+            bloomEnsureBlocks(&orderBloom, blocks);
+            ok = fread(orderBloom.bits, sizeof(unsigned long long), blocks * wordsPerBlock, f) ==
+                 (size_t)(blocks * wordsPerBlock);
+        }
+        fclose(f);
+    }
+
+    if (!ok)
+        rebuildOrderBloom(orderHistory, indexGap);
+}
+
+// Filtro do bloco de key: 0 = com certeza nao existe ordem ativa com esse id
+int orderMayExist(long long order_id)
+{
+    if (!orderBloom.bits || !orderSparse.entries)
+        return 1;
+    return bloomMayContain(&orderBloom, residentSlot(&orderSparse, order_id), order_id);
+}
+
+// Registra uma ordem nova no filtro do seu bloco
+void orderBloomAdd(long long order_id)
+{
+    if (!orderBloom.bits || !orderSparse.entries)
+        return;
+
+    long slot = residentSlot(&orderSparse, order_id);
+    if (slot < 0)
+        return;
+    bloomAdd(&orderBloom, slot, order_id);
+    saveBloomBlock(&orderBloom, slot, orderSparse.count);
+}
+
+// Refaz as zone maps pelos dados: registros do arquivo principal no bloco fisico onde estao,
+// overflow no bloco da sua cadeia
+void rebuildOrderZones(FILE *orderHistory)
+{
+    initZoneMaps(&orderZones);
+    if (!orderSparse.entries || orderSparse.count == 0)
+        return;
+    zoneMapsEnsureBlocks(&orderZones, orderSparse.count);
+
+    RUN_READER reader;
+    fflush(orderHistory);
+    if (openRunReader(&reader, "../data/orderHistory.dat", sizeof(ORDER)))
+    {
+        ORDER *order;
+        long position = 0, block = 0;
+        while ((order = runReaderCurrent(&reader)) != NULL)
+        {
+            while (block + 1 < orderSparse.count && orderSparse.entries[block + 1].position <= position)
+                block++;
+            if (!isOrderRemoved(order))
+                zoneAdd(&orderZones, block, order);
+            position += sizeof(ORDER);
+            runReaderAdvance(&reader);
+        }
+        closeRunReader(&reader);
+    }
+
+    if (overflowChains.isOpen)
+    {
+        OVERFLOW_RECORD overflow;
+        fseek(overflowChains.file, 0, SEEK_SET);
+        while (fread(&overflow, sizeof(OVERFLOW_RECORD), 1, overflowChains.file) == 1)
+        {
+            if (!isOrderRemoved(&overflow.record))
+                zoneAdd(&orderZones, residentSlot(&orderSparse, overflow.record.order_id), &overflow.record);
+        }
+    }
+
+    saveZoneMaps(&orderZones, orderSparse.count);
+}
+
+// Insercao: regrava so o ZONE_MAP do bloco (e os blocos novos do indice, com o contador)
+void saveZoneBlock(ZONE_MAPS *maps, long block, long blocks)
+{
+    zoneMapsEnsureBlocks(maps, blocks);
+    long header[1] = {blocks};
+    if (!saveFileBlocks("../data/orderZones.zm", header, sizeof(header), maps->zones, sizeof(ZONE_MAP), block, blocks))
+        saveZoneMaps(maps, blocks);
+}
+
+// Carrega orderZones.zm (gravado no merge); se nao bater com o indice, refaz pelos dados
+void loadOrderZones(FILE *orderHistory)
+{
+    initZoneMaps(&orderZones);
+    if (!orderSparse.entries)
+        return;
+
+    long blocks = 0;
+    int ok = 0;
+    FILE *f = fopen("../data/orderZones.zm", "rb");
+    if (f)
+    {
+        ok = fread(&blocks, sizeof(long), 1, f) == 1 && blocks == orderSparse.count;
+        if (ok)
+        {
+            zoneMapsEnsureBlocks(&orderZones, blocks);
+            ok = fread(orderZones.zones, sizeof(ZONE_MAP), blocks, f) == (size_t)blocks;
+        }
+        fclose(f);
+    }
+
+    if (!ok)
+        rebuildOrderZones(orderHistory);
+}
+
+// Ordem inserida: block e o bloco fisico (fim do arquivo) ou o da cadeia de overflow
+void orderZoneAdd(long block, ORDER *order)
+{
+    if (!orderZones.zones || block < 0)
+        return;
+    zoneAdd(&orderZones, block, order);
+    saveZoneBlock(&orderZones, block, orderSparse.count);
+}
+
+// Posicao no arquivo principal da primeira ocorrencia ativa de order_id, ou -1
+long findOrderPosition(FILE *orderHistory, FILE *orderIndex, long long order_id, int indexGap)
+{
+    long blockPos = findBlockPosition(&orderSparse, orderIndex, order_id);
+    if (blockPos < 0)
+        return -1;
+
+    long count;
+    ORDER *block = (ORDER *)readBlock(orderHistory, blockPos, indexGap, sizeof(ORDER), &count);
+
+    for (long i = blockLowerBound((char *)block, count, sizeof(ORDER), offsetof(ORDER, order_id), order_id);
+         i < count && block[i].order_id == order_id; i++)
+    {
+        if (!isOrderRemoved(&block[i]))
+            return blockPos + i * sizeof(ORDER);
+    }
+    return -1;
+}
+
+// 0 se a carga foi abortada na geracao dos runs
+int readCSVExternalSort(FILE *csv, FILE *orderHistory, FILE *orderIndex,
+                         FILE *jewelryRegister, FILE *jewelryIndex,
+                         FILE *categoryRegister, FILE *categoryIndex, int indexGap)
+{
+    printf("Limite memoria: %d registros\n", MEMORY_LIMIT);
+    printf("Threads de carga: %d\n", config.ingestThreads);
+    printf("Fan-in do merge: %d\n", config.mergeFanIn);
+    printf("Geracao de runs: %s\n", config.runStrategy == RUN_STRATEGY_REPLACEMENT ? "selecao por substituicao" : "ordenacao do buffer");
+    if (config.runStrategy == RUN_STRATEGY_SORT)
+        printf("Gravacao dos runs: %s\n", config.asyncSpill ? "em segundo plano" : "sincrona");
+    printf("Diretorios de spill:");
+    for (int i = 0; i < config.numSpillDirs; i++)
+        printf(" %s", config.spillDirs[i]);
+    printf("\n");
+    printf("Limite indice: %d\n\n", indexGap);
+
+    int numOrderRuns, numJewelryRuns, numCategoryRuns;
+    if (createSortedRuns(csv, &numOrderRuns, &numJewelryRuns, &numCategoryRuns) < 0)
+    {
+        printf("Carga abortada.\n");
+        return 0;
+    }
+    mergeOrderRuns(numOrderRuns, orderHistory, orderIndex, indexGap);
+    mergeJewelryRuns(numJewelryRuns, jewelryRegister, jewelryIndex, indexGap);
+    processCategoryData(jewelryRegister, categoryRegister, categoryIndex, indexGap);
+
+    bptCreate("../data/orderIndex.bpt", orderIndex);
+    bptCreate("../data/jewelryIndex.bpt", jewelryIndex);
+    bptCreate("../data/categoryIndex.bpt", categoryIndex);
+    return 1;
+}
+
+// ------------------------------ Cursor por intervalo de order_id ------------------------------
+
+int comparePending(const void *a, const void *b)
+{
+    const CURSOR_PENDING *x = a, *y = b;
+    if (x->record.order_id != y->record.order_id)
+        return (x->record.order_id > y->record.order_id) - (x->record.order_id < y->record.order_id);
+    return (x->sequence > y->sequence) - (x->sequence < y->sequence);
+}
+
+void addCursorPending(ORDER_CURSOR *cursor, ORDER *record)
+{
+    if (isOrderRemoved(record) || record->order_id < cursor->lo || record->order_id > cursor->hi)
+        return;
+
+    if (cursor->pendingCount == cursor->pendingCapacity)
+    {
+        cursor->pendingCapacity = cursor->pendingCapacity ? cursor->pendingCapacity * 2 : 64;
+        cursor->pending = realloc(cursor->pending, cursor->pendingCapacity * sizeof(CURSOR_PENDING));
+    }
+    cursor->pending[cursor->pendingCount].record = *record;
+    cursor->pending[cursor->pendingCount].sequence = cursor->pendingCount;
+    cursor->pendingCount++;
+}
+
+// Proximo bloco de leitura antecipada do trecho ordenado
+void cursorRefill(ORDER_CURSOR *cursor)
+{
+    long records = (cursor->sortedEnd - cursor->position) / (long)sizeof(ORDER);
+    if (records > RUN_READ_BUFFER / (long)sizeof(ORDER))
+        records = RUN_READ_BUFFER / sizeof(ORDER);
+
+    cursor->index = 0;
+    cursor->count = 0;
+    if (records > 0)
+    {
+        fseek(cursor->orderHistory, cursor->position, SEEK_SET);
+        cursor->count = fread(cursor->buffer, sizeof(ORDER), records, cursor->orderHistory);
+        cursor->position += cursor->count * sizeof(ORDER);
+    }
+    if (cursor->count == 0)
+        cursor->mainDone = 1;
+}
+
+// Primeiro registro ativo do trecho ordenado dentro de [lo, hi], sem consumi-lo
+ORDER *cursorMainPeek(ORDER_CURSOR *cursor)
+{
+    while (!cursor->mainDone)
+    {
+        if (cursor->index >= cursor->count)
+        {
+            cursorRefill(cursor);
+            continue;
+        }
+
+        ORDER *order = &cursor->buffer[cursor->index];
+        if (order->order_id > cursor->hi)
+        {
+            cursor->mainDone = 1;
+            break;
+        }
+        if (order->order_id >= cursor->lo && !isOrderRemoved(order))
+            return order;
+        cursor->index++;
+    }
+    return NULL;
+}
+
+void openOrderCursor(ORDER_CURSOR *cursor, FILE *orderHistory, FILE *orderIndex, FILE *orderOverflow,
+                     long long lo, long long hi)
+{
+    memset(cursor, 0, sizeof(ORDER_CURSOR));
+    cursor->orderHistory = orderHistory;
+    cursor->lo = lo;
+    cursor->hi = hi;
+    cursor->buffer = malloc(RUN_READ_BUFFER);
+
+    fflush(orderHistory);
+    fseek(orderHistory, 0, SEEK_END);
+    long fileSize = ftell(orderHistory);
+
+    // Um order_id pode atravessar o inicio de um bloco: comeca no bloco anterior a lo
+    long start = findBlockPosition(&orderSparse, orderIndex, lo > LLONG_MIN ? lo - 1 : lo);
+    if (start < 0)
+        start = 0;
+
+    long tail = 0;
+    if (orderSparse.entries && orderSparse.count > 0)
+        tail = orderSparse.entries[orderSparse.count - 1].position;
+    else if (fseek(orderIndex, -(long)sizeof(INDEX), SEEK_END) == 0)
+    {
+        INDEX last;
+        if (fread(&last, sizeof(INDEX), 1, orderIndex) == 1)
+            tail = last.position;
+    }
+    if (tail < start)
+        tail = start;
+    if (tail > fileSize)
+        tail = fileSize;
+
+    cursor->position = start;
+    cursor->sortedEnd = tail;
+
+    // Cauda do arquivo: pode ter insercoes fora de ordem
+    fseek(orderHistory, tail, SEEK_SET);
+    long count;
+    while ((count = fread(cursor->buffer, sizeof(ORDER), RUN_READ_BUFFER / sizeof(ORDER), orderHistory)) > 0)
+    {
+        for (long i = 0; i < count; i++)
+            addCursorPending(cursor, &cursor->buffer[i]);
+    }
+
+    // Overflow: so as cadeias dos blocos do intervalo, ou o arquivo todo sem indice residente
+    OVERFLOW_RECORD overflow;
+    if (orderOverflow && orderSparse.entries && overflowChains.isOpen)
+    {
+        long first = residentSlot(&orderSparse, lo);
+        long last = residentSlot(&orderSparse, hi);
+        for (long slot = first < 0 ? 0 : first; slot <= last; slot++)
+        {
+            for (long offset = overflowHead(&overflowChains, orderSparse.entries[slot].position); offset >= 0;
+                 offset = overflow.nextOverflow)
+            {
+                fseek(orderOverflow, offset, SEEK_SET);
+                if (fread(&overflow, sizeof(OVERFLOW_RECORD), 1, orderOverflow) != 1)
+                    break;
+                addCursorPending(cursor, &overflow.record);
+            }
+        }
+    }
+    else if (orderOverflow)
+    {
+        fseek(orderOverflow, 0, SEEK_SET);
+        while (fread(&overflow, sizeof(OVERFLOW_RECORD), 1, orderOverflow) == 1)
+            addCursorPending(cursor, &overflow.record);
+    }
+
+    qsort(cursor->pending, cursor->pendingCount, sizeof(CURSOR_PENDING), comparePending);
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fileno(orderHistory), start, tail - start, POSIX_FADV_SEQUENTIAL);
+#endif
+    cursor->count = 0;
+    cursor->index = 0;
+}
+
+// Proxima ordem do intervalo em ordem de order_id (empates: arquivo principal primeiro); NULL no fim
+ORDER *orderCursorNext(ORDER_CURSOR *cursor)
+{
+    ORDER *main = cursorMainPeek(cursor);
+    ORDER *pending = cursor->pendingIndex < cursor->pendingCount ? &cursor->pending[cursor->pendingIndex].record : NULL;
+
+    if (main && (!pending || main->order_id <= pending->order_id))
+    {
+        cursor->index++;
+        return main;
+    }
+    if (pending)
+    {
+        cursor->pendingIndex++;
+        return pending;
+    }
+    return NULL;
+}
+
+void closeOrderCursor(ORDER_CURSOR *cursor)
+{
+    free(cursor->buffer);
+    free(cursor->pending);
+    memset(cursor, 0, sizeof(ORDER_CURSOR));
+}
+
+// ------------------------------ Carga incremental ------------------------------
+// Um lote novo de CSV vira runs ordenados que sao intercalados com os arquivos existentes,
+// lidos sequencialmente como mais um run. O custo e ordenar o lote e fazer uma passada
+// pelos arquivos atuais, sem reprocessar o CSV historico.
+
+// Fecha o arquivo atual, coloca o temporario no lugar e reabre em modo rb+
+void replaceDataFile(FILE **file, FILE *newFile, const char *path, const char *tempPath)
+{
+    fclose(*file);
+    fclose(newFile);
+    remove(path);
+    rename(tempPath, path);
+    *file = openFile(path, "rb+");
+}
+
+// Grava as ordens ativas do overflow como um run ordenado; retorna 1 se o run foi criado
+int spillOverflowRun(FILE *orderOverflow, int runNum)
+{
+    fseek(orderOverflow, 0, SEEK_END);
+    long total = ftell(orderOverflow) / sizeof(OVERFLOW_RECORD);
+    if (total == 0)
+        return 0;
+
+    ORDER *orders = malloc(total * sizeof(ORDER));
+    long count = 0;
+    OVERFLOW_RECORD overflow;
+
+    fseek(orderOverflow, 0, SEEK_SET);
+    while (fread(&overflow, sizeof(OVERFLOW_RECORD), 1, orderOverflow) == 1)
+    {
+        if (!isOrderRemoved(&overflow.record))
+            orders[count++] = overflow.record;
+    }
+
+    if (count > 0)
+    {
+        sortRecordsByKey(orders, count, sizeof(ORDER), offsetof(ORDER, order_id));
+
+        char filename[RUN_PATH_MAX];
+        runFileName(filename, "order", runNum);
+        FILE *f = fopen(filename, "wb");
+        fwrite(orders, sizeof(ORDER), count, f);
+        fclose(f);
+    }
+
+    free(orders);
+    return count > 0;
+}
+
+// Soma os agregados de categoria ja gravados aos do lote (temp_category_run_0.dat)
+void mergeCategoryDelta(FILE *categoryRegister, int numCategoryRuns)
+{
+    fseek(categoryRegister, 0, SEEK_END);
+    long existingCount = ftell(categoryRegister) / sizeof(CATEGORY);
+    CATEGORY *existing = malloc((existingCount + 1) * sizeof(CATEGORY));
+    fseek(categoryRegister, 0, SEEK_SET);
+    existingCount = fread(existing, sizeof(CATEGORY), existingCount, categoryRegister);
+
+    long batchCount = 0;
+    CATEGORY *batch = NULL;
+    FILE *tempCat = (numCategoryRuns > 0) ? fopen("../data/temp_category_run_0.dat", "rb") : NULL;
+    if (tempCat)
+    {
+        fseek(tempCat, 0, SEEK_END);
+        batchCount = ftell(tempCat) / sizeof(CATEGORY);
+        fseek(tempCat, 0, SEEK_SET);
+        batch = malloc((batchCount + 1) * sizeof(CATEGORY));
+        batchCount = fread(batch, sizeof(CATEGORY), batchCount, tempCat);
+        fclose(tempCat);
+    }
+
+    // Os dois vetores estao ordenados por category_id
+    CATEGORY *merged = malloc((existingCount + batchCount + 1) * sizeof(CATEGORY));
+    long i = 0, j = 0, count = 0;
+
+    while (i < existingCount || j < batchCount)
+    {
+        if (j >= batchCount || (i < existingCount && existing[i].category_id < batch[j].category_id))
+        {
+            merged[count++] = existing[i++];
+        }
+        else if (i >= existingCount || batch[j].category_id < existing[i].category_id)
+        {
+            merged[count++] = batch[j++];
+        }
+        else
+        {
+            merged[count] = existing[i++];
+            merged[count].total_sales += batch[j].total_sales;
+            merged[count].total_revenue += batch[j].total_revenue;
+            count++;
+            j++;
+        }
+    }
+
+    // processCategoryData reconta os produtos de cada categoria
+    for (long k = 0; k < count; k++)
+        merged[k].product_count = 0;
+
+    FILE *out = fopen("../data/temp_category_run_0.dat", "wb");
+    fwrite(merged, sizeof(CATEGORY), count, out);
+    fclose(out);
+
+    free(existing);
+    free(batch);
+    free(merged);
+}
+
+int loadDeltaCSV(const char *csvPath, FILE **orderHistory, FILE **orderIndex,
+                 FILE **jewelryRegister, FILE **jewelryIndex, FILE **categoryRegister,
+                 FILE **categoryIndex, FILE **orderOverflow, int indexGap)
+{
+    FILE *csv = openFile(csvPath, "r");
+    if (!csv)
+        return 0;
+
+    printf("\n=== CARGA INCREMENTAL: %s ===\n", csvPath);
+
+    int numOrderRuns, numJewelryRuns, numCategoryRuns;
+    int created = createSortedRuns(csv, &numOrderRuns, &numJewelryRuns, &numCategoryRuns);
+    fclose(csv);
+    if (created < 0)
+    {
+        printf("Carga abortada: arquivos atuais mantidos.\n");
+        return 0;
+    }
+
+    fflush(*orderHistory);
+    fflush(*jewelryRegister);
+    fflush(*orderOverflow);
+
+    // Ordens: arquivo atual (leitor 0, vence empates), overflow e runs do lote
+    numOrderRuns = reduceRuns("order", numOrderRuns, sizeof(ORDER), offsetof(ORDER, order_id), 2);
+    numOrderRuns += spillOverflowRun(*orderOverflow, numOrderRuns);
+
+    RUN_READER *readers = malloc((numOrderRuns + 1) * sizeof(RUN_READER));
+    openRunReader(&readers[0], "../data/orderHistory.dat", sizeof(ORDER));
+    for (int i = 0; i < numOrderRuns; i++)
+    {
+        char filename[RUN_PATH_MAX];
+        runFileName(filename, "order", i);
+        openRunReader(&readers[i + 1], filename, sizeof(ORDER));
+    }
+
+    FILE *newHistory = openFile("../data/orderHistory.tmp", "wb+");
+    FILE *newIndex = openFile("../data/orderIndex.tmp", "wb+");
+    mergeOrderReaders(readers, numOrderRuns + 1, newHistory, newIndex, indexGap);
+    closeRunReader(&readers[0]);
+    closeRuns("order", readers + 1, 0, numOrderRuns);
+    free(readers);
+
+    replaceDataFile(orderHistory, newHistory, "../data/orderHistory.dat", "../data/orderHistory.tmp");
+    replaceDataFile(orderIndex, newIndex, "../data/orderIndex.idx", "../data/orderIndex.tmp");
+    fclose(*orderOverflow);
+    *orderOverflow = openFile("../data/orderOverflow.dat", "wb+");
+
+    // Joias: cadastro atual primeiro, entao um produto ja cadastrado mantem seus dados
+    numJewelryRuns = reduceRuns("jewelry", numJewelryRuns, sizeof(JEWELRY), offsetof(JEWELRY, product_id), 1);
+
+    readers = malloc((numJewelryRuns + 1) * sizeof(RUN_READER));
+    openRunReader(&readers[0], "../data/jewelryRegister.dat", sizeof(JEWELRY));
+    for (int i = 0; i < numJewelryRuns; i++)
+    {
+        char filename[RUN_PATH_MAX];
+        runFileName(filename, "jewelry", i);
+        openRunReader(&readers[i + 1], filename, sizeof(JEWELRY));
+    }
+
+    FILE *newRegister = openFile("../data/jewelryRegister.tmp", "wb+");
+    FILE *newJewelryIndex = openFile("../data/jewelryIndex.tmp", "wb+");
+    mergeJewelryReaders(readers, numJewelryRuns + 1, newRegister, newJewelryIndex, indexGap);
+    closeRunReader(&readers[0]);
+    closeRuns("jewelry", readers + 1, 0, numJewelryRuns);
+    free(readers);
+
+    replaceDataFile(jewelryRegister, newRegister, "../data/jewelryRegister.dat", "../data/jewelryRegister.tmp");
+    replaceDataFile(jewelryIndex, newJewelryIndex, "../data/jewelryIndex.idx", "../data/jewelryIndex.tmp");
+
+    // Categorias: agregados antigos + lote; product_count e recontado a partir das joias
+    mergeCategoryDelta(*categoryRegister, numCategoryRuns);
+    fflush(*categoryRegister);
+    fflush(*categoryIndex);
+    ftruncate(fileno(*categoryRegister), 0);
+    ftruncate(fileno(*categoryIndex), 0);
+    fseek(*categoryRegister, 0, SEEK_SET);
+    fseek(*categoryIndex, 0, SEEK_SET);
+    processCategoryData(*jewelryRegister, *categoryRegister, *categoryIndex, indexGap);
+
+    reloadSparseIndex(&orderSparse, *orderIndex);
+    reloadSparseIndex(&jewelrySparse, *jewelryIndex);
+    reloadSparseIndex(&categorySparse, *categoryIndex);
+    if (overflowChains.isOpen)
+        openOverflowChains(&overflowChains, *orderOverflow, *orderIndex);
+
+    removal_count = 0;
+    return 1;
+}
+
+CATEGORY *searchCategoryById(FILE *categoryRegister, FILE *categoryIndex,
+                             long long int category_id, int indexGap)
+{
+    long startPosition = findBlockPosition(&categorySparse, categoryIndex, category_id);
+    if (startPosition < 0)
+        return NULL;
+
+    long count;
+    CATEGORY *block = (CATEGORY *)readBlock(categoryRegister, startPosition, indexGap, sizeof(CATEGORY), &count);
+    long i = blockLowerBound((char *)block, count, sizeof(CATEGORY), offsetof(CATEGORY, category_id), category_id);
+    if (i >= count || block[i].category_id != category_id)
+        return NULL;
+
+    CATEGORY *category = malloc(sizeof(CATEGORY));
+    if (category)
+        *category = block[i];
+    return category;
+}
+
+int updateCategorySales(FILE *categoryRegister, FILE *categoryIndex,
+                        long long int category_id, int quantity, float revenue, int indexGap)
+{
+    CATEGORY *cat = searchCategoryById(categoryRegister, categoryIndex, category_id, indexGap);
+
+    if (!cat)
+    {
+        printf("Categoria %lld nao encontrada\n", category_id);
+        return 0;
+    }
+
+    cat->total_sales += quantity;
+    cat->total_revenue += revenue;
+
+    // Encontra posição no arquivo e atualiza
+    fseek(categoryRegister, 0, SEEK_SET);
+    CATEGORY temp;
+    long pos = 0;
+
+    while (fread(&temp, sizeof(CATEGORY), 1, categoryRegister) == 1)
+    {
+        if (temp.category_id == category_id)
+        {
+            fseek(categoryRegister, pos, SEEK_SET);
+            fwrite(cat, sizeof(CATEGORY), 1, categoryRegister);
+            fflush(categoryRegister);
+            free(cat);
+            return 1;
+        }
+        pos += sizeof(CATEGORY);
+    }
+
+    free(cat);
+    return 0;
+}
+
+
+// RESPONDE: Qual a categoria com mais itens vendidos?-------------------------------------------------
+void findBestSellingCategory(FILE *categoryRegister)
+{
+    fseek(categoryRegister, 0, SEEK_END);
+    long totalCategories = ftell(categoryRegister) / sizeof(CATEGORY);
+
+    if (totalCategories == 0)
+    {
+        printf("Nenhuma categoria encontrada.\n");
+        return;
+    }
+
+    printf("Analisando %ld categorias...\n\n", totalCategories);
+
+    // Carrega todas as categorias
+    CATEGORY *categories = malloc(totalCategories * sizeof(CATEGORY));
+    fseek(categoryRegister, 0, SEEK_SET);
+    fread(categories, sizeof(CATEGORY), totalCategories, categoryRegister);
+
+    // Ordena por total_sales
+    quicksort(categories, totalCategories, sizeof(CATEGORY), compareCategorySales);
+
+    // Exibe TOP 10
+    printf("=== TOP 10 CATEGORIAS ===\n");
+    printf("%-4s %-15s %-30s %-12s %-15s %-12s\n",
+           "Pos", "Category ID", "Alias", "Produtos", "Vendas", "Receita");
+    printf("------------------------------------------------------------------------------------\n");
+
+    int limit = (totalCategories < 10) ? totalCategories : 10;
+    for (int i = 0; i < limit; i++)
+    {
+        printf("%-4d %-15lld %-30s %-12d %-15d $%-11.2f\n",
+               i + 1,
+               categories[i].category_id,
+               categories[i].category_alias,
+               categories[i].product_count,
+               categories[i].total_sales,
+               categories[i].total_revenue);
+    }
+    printf("------------------------------------------------------------------------------------\n\n");
+    free(categories);
+}
+
+ORDER *searchOrderById(FILE *orderHistory, FILE *orderIndex, FILE *orderOverflow,
+                       long long int target_id, int indexGap)
+{
+    if (!orderMayExist(target_id))
+        return NULL;
+
+    ORDER *order = malloc(sizeof(ORDER));
+    if (!order)
+        return NULL;
+
+    int learned = -1;
+    if (learnedIndex.segments)
+    {
+        learned = learnedSearch(orderHistory, &learnedIndex, target_id, order);
+        if (learned == 1)
+            return order;
+    }
+
+    long startPosition = (learned < 0) ? findBlockPosition(&orderSparse, orderIndex, target_id) : -1;
+    if (learned < 0 && startPosition < 0)
+    {
+        free(order);
+        return NULL;
+    }
+
+    if (startPosition >= 0)
+    {
+        long count;
+        ORDER *block = (ORDER *)readBlock(orderHistory, startPosition, indexGap, sizeof(ORDER), &count);
+
+        for (long i = blockLowerBound((char *)block, count, sizeof(ORDER), offsetof(ORDER, order_id), target_id);
+             i < count && block[i].order_id == target_id; i++)
+        {
+            if (!isOrderRemoved(&block[i]))
+            {
+                *order = block[i];
+                return order;
+            }
+        }
+    }
+
+    if (orderOverflow)
+    {
+        OVERFLOW_RECORD overflow;
+        if (findOverflowRecord(orderOverflow, orderBlockOf(orderIndex, target_id), target_id, &overflow) >= 0)
+        {
+            *order = overflow.record;
+            return order;
+        }
+    }
+
+    free(order);
+    return NULL;
+}
+
+// Busca varias ordens de uma vez: results[i]/found[i] correspondem a keys[i]. Retorna quantas achou
+long searchOrdersBatch(FILE *orderHistory, FILE *orderIndex, FILE *orderOverflow, const long long *keys,
+                       long count, ORDER *results, int *found, int indexGap)
+{
+    BATCH_PROBE *probes = sortBatchProbes(keys, count);
+    memset(found, 0, count * sizeof(int));
+
+    long loadedBlock = -1, blockCount = 0, slot = 0, hits = 0;
+    ORDER *block = NULL;
+    OVERFLOW_RECORD *chain = NULL;
+    long chainCount = -1, chainCapacity = 0; // -1: cadeia do bloco ainda nao lida
+
+    for (long p = 0; p < count; p++)
+    {
+        long long key = probes[p].key;
+
+        if (p > 0 && key == probes[p - 1].key)
+        {
+            long previous = probes[p - 1].slot;
+            if (found[previous])
+            {
+                results[probes[p].slot] = results[previous];
+                found[probes[p].slot] = 1;
+                hits++;
+            }
+            continue;
+        }
+        if (!orderMayExist(key))
+            continue;
+
+        long blockPos = batchBlockPosition(&orderSparse, orderIndex, key, &slot);
+        if (blockPos < 0)
+            continue;
+        if (blockPos != loadedBlock)
+        {
+            block = (ORDER *)readBlock(orderHistory, blockPos, indexGap, sizeof(ORDER), &blockCount);
+            loadedBlock = blockPos;
+            chainCount = -1;
+        }
+
+        ORDER *match = NULL;
+        for (long i = blockLowerBound((char *)block, blockCount, sizeof(ORDER), offsetof(ORDER, order_id), key);
+             i < blockCount && block[i].order_id == key; i++)
+        {
+            if (!isOrderRemoved(&block[i]))
+            {
+                match = &block[i];
+                break;
+            }
+        }
+
+        if (!match && orderOverflow)
+        {
+            if (chainCount < 0)
+            {
+                chainCount = 0;
+                for (long offset = overflowHead(&overflowChains, blockPos); offset >= 0;
+                     offset = chain[chainCount++].nextOverflow)
+                {
+                    if (chainCount == chainCapacity)
+                    {
+                        chainCapacity = chainCapacity ? chainCapacity * 2 : 16;
+                        chain = realloc(chain, chainCapacity * sizeof(OVERFLOW_RECORD));
+                    }
+                    fseek(orderOverflow, offset, SEEK_SET);
+                    if (fread(&chain[chainCount], sizeof(OVERFLOW_RECORD), 1, orderOverflow) != 1)
+                        break;
+                }
+            }
+            for (long c = 0; c < chainCount && !match; c++)
+            {
+                if (chain[c].record.order_id == key && !isOrderRemoved(&chain[c].record))
+                    match = &chain[c].record;
+            }
+        }
+
+        if (match)
+        {
+            results[probes[p].slot] = *match;
+            found[probes[p].slot] = 1;
+            hits++;
+        }
+    }
+
+    free(chain);
+    free(probes);
+    return hits;
+}
+
+int insertOrderWithOverflow(ORDER *newOrder, FILE *orderHistory, FILE *orderIndex,
+                            FILE *orderOverflow, FILE *categoryRegister,
+                            FILE *categoryIndex, int indexGap)
+{
+
+    fseek(orderHistory, 0, SEEK_END);
+    long fileSize = ftell(orderHistory);
+    long totalRecords = fileSize / sizeof(ORDER);
+
+    if (totalRecords == 0)
+    {
+        writeNewPage(orderHistory, 0, newOrder, indexGap);
+        appendIndexEntry(&orderSparse, orderIndex, newOrder->order_id, 0);
+
+        orderBloomAdd(newOrder->order_id);
+        logProductPosting(newOrder->product_id, 0);
+        orderZoneAdd(0, newOrder);
+        orderBitmapsInsert(newOrder, 0, indexGap);
+
+        // Atualiza categoria
+        updateCategorySales(categoryRegister, categoryIndex, newOrder->category_id,
+                            newOrder->quantity, centsToUsd(newOrder->price_cents) * newOrder->quantity, indexGap);
+        return 1;
+    }
+
+    long blockStart = findBlockPosition(&orderSparse, orderIndex, newOrder->order_id);
+    if (blockStart < 0)
+        blockStart = 0;
+
+    // Pagina inteira em uma leitura; os slots livres ficam no fim dela
+    long count;
+    ORDER *page = (ORDER *)readBlock(orderHistory, blockStart, indexGap, sizeof(ORDER), &count);
+    long used = count;
+    while (used > 0 && isOrderFree(&page[used - 1]))
+        used--;
+
+    long firstRecord = blockStart / sizeof(ORDER);
+    int lastPage = blockStart + (long)indexGap * (long)sizeof(ORDER) >= fileSize;
+
+    if (used < indexGap)
+    {
+        // Depois das ordens com o mesmo id; desloca o resto da pagina um slot
+        long slot = blockLowerBound((char *)page, used, sizeof(ORDER), offsetof(ORDER, order_id), newOrder->order_id + 1);
+        if (newOrder->order_id == LLONG_MAX)
+            slot = used;
+
+        PRODUCT_POSTING *moved = malloc((used - slot + 1) * sizeof(PRODUCT_POSTING));
+        long movedCount = 0;
+        for (long i = used - 1; i >= slot; i--)
+        {
+            page[i + 1] = page[i];
+            orderBitmapsMove(&page[i + 1], firstRecord + i, firstRecord + i + 1);
+            if (!isOrderRemoved(&page[i + 1]))
+            {
+                moved[movedCount].product_id = page[i + 1].product_id;
+                moved[movedCount++].location = firstRecord + i + 1;
+            }
+        }
+        page[slot] = *newOrder;
+        moved[movedCount].product_id = newOrder->product_id;
+        moved[movedCount++].location = firstRecord + slot;
+
+        // Nova maior chave da pagina: os slots livres passam a repeti-la
+        long written = used - slot + 1;
+        if (slot == used)
+        {
+            for (long i = used + 1; i < count; i++)
+                page[i].order_id = newOrder->order_id;
+            written = (count > used + 1 ? count : used + 1) - slot;
+        }
+
+        fseek(orderHistory, blockStart + slot * sizeof(ORDER), SEEK_SET);
+        fwrite(&page[slot], sizeof(ORDER), written, orderHistory);
+        fflush(orderHistory);
+        writeColumns(&columnStore, firstRecord + slot, &page[slot], written);
+
+        logProductPostings(moved, movedCount);
+        free(moved);
+
+        fseek(orderHistory, 0, SEEK_END);
+        orderZoneAdd(residentSlot(&orderSparse, newOrder->order_id), newOrder);
+        orderBitmapsInsert(newOrder, firstRecord + slot, ftell(orderHistory) / sizeof(ORDER));
+        printf("\n**Registro inserido na pagina (%ld de %d slots usados)\n", used + 1, indexGap);
+    }
+    else if (lastPage && newOrder->order_id > page[used - 1].order_id)
+    {
+        // Ultima pagina cheia e chave no fim: abre uma pagina nova sem quebrar a ordem do arquivo
+        long newPage = firstRecord + indexGap;
+        writeNewPage(orderHistory, newPage * sizeof(ORDER), newOrder, indexGap);
+        appendIndexEntry(&orderSparse, orderIndex, newOrder->order_id, newPage * sizeof(ORDER));
+
+        logProductPosting(newOrder->product_id, newPage);
+        orderZoneAdd(orderSparse.count - 1, newOrder);
+        orderBitmapsInsert(newOrder, newPage, newPage + indexGap);
+        printf("\n**Pagina cheia, nova pagina criada no fim do arquivo\n");
+    }
+    else
+    {
+        // Pagina do meio cheia: sem divisao de pagina, vai para a cadeia de overflow do bloco
+        printf("\n**Pagina cheia, usando overflow...\n");
+
+        OVERFLOW_RECORD overflow;
+        overflow.record = *newOrder;
+        overflow.originalBlockPos = blockStart;
+        overflow.nextOverflow = overflowHead(&overflowChains, blockStart);
+
+        fseek(orderOverflow, 0, SEEK_END);
+        long offset = ftell(orderOverflow);
+        fwrite(&overflow, sizeof(OVERFLOW_RECORD), 1, orderOverflow);
+        fflush(orderOverflow);
+        setOverflowHead(&overflowChains, blockStart, offset);
+        logProductPosting(newOrder->product_id, -(offset + 1));
+        orderZoneAdd(residentSlot(&orderSparse, newOrder->order_id), newOrder);
+        orderBitmapsInsertOverflow(newOrder, offset);
+
+        printf("**Registro inserido em overflow\n");
+    }
+
+    orderBloomAdd(newOrder->order_id);
+
+    // Cada deslocamento na pagina loga as novas posicoes; o log e varrido em toda consulta por produto
+    if (productIndex.logCount * PRODUCT_LOG_FRACTION > productIndex.recordCount)
+    {
+        printf("Compactando o log do indice de produtos...\n");
+        rebuildProductIndex(orderHistory, orderOverflow);
+    }
+
+    // Atualiza categoria
+    updateCategorySales(categoryRegister, categoryIndex, newOrder->category_id,
+                        newOrder->quantity, centsToUsd(newOrder->price_cents) * newOrder->quantity, indexGap);
+
+    return 1;
+}
+
+JEWELRY *searchJewelryById(FILE *jewelryRegister, FILE *jewelryIndex,
+                           long long int product_id, int indexGap)
+{
+    long startPosition = findBlockPosition(&jewelrySparse, jewelryIndex, product_id);
+    if (startPosition < 0)
+        return NULL;
+
+    long count;
+    JEWELRY *block = (JEWELRY *)readBlock(jewelryRegister, startPosition, indexGap, sizeof(JEWELRY), &count);
+    long i = blockLowerBound((char *)block, count, sizeof(JEWELRY), offsetof(JEWELRY, product_id), product_id);
+    if (i >= count || block[i].product_id != product_id)
+        return NULL;
+
+    JEWELRY *jewelry = malloc(sizeof(JEWELRY));
+    if (jewelry)
+        *jewelry = block[i];
+    return jewelry;
+}
+
+// Versao em lote de searchJewelryById: results[i]/found[i] correspondem a keys[i]
+long searchJewelryBatch(FILE *jewelryRegister, FILE *jewelryIndex, const long long *keys, long count,
+                        JEWELRY *results, int *found, int indexGap)
+{
+    BATCH_PROBE *probes = sortBatchProbes(keys, count);
+    memset(found, 0, count * sizeof(int));
+
+    long loadedBlock = -1, blockCount = 0, slot = 0, hits = 0;
+    JEWELRY *block = NULL;
+
+    for (long p = 0; p < count; p++)
+    {
+        long blockPos = batchBlockPosition(&jewelrySparse, jewelryIndex, probes[p].key, &slot);
+        if (blockPos < 0)
+            continue;
+        if (blockPos != loadedBlock)
+        {
+            block = (JEWELRY *)readBlock(jewelryRegister, blockPos, indexGap, sizeof(JEWELRY), &blockCount);
+            loadedBlock = blockPos;
+        }
+
+        long i = blockLowerBound((char *)block, blockCount, sizeof(JEWELRY), offsetof(JEWELRY, product_id), probes[p].key);
+        if (i < blockCount && block[i].product_id == probes[p].key)
+        {
+            results[probes[p].slot] = block[i];
+            found[probes[p].slot] = 1;
+            hits++;
+        }
+    }
+
+    free(probes);
+    return hits;
+}
+
+
+// ------------------------------ Vendas por produto (indice secundario) ------------------------------
+
+// Carrega productIndex.dat e o log; se o arquivo nao corresponder aos dados, refaz
+void loadProductIndex(FILE *orderHistory, FILE *orderOverflow)
+{
+    freeProductIndex(&productIndex);
+
+    fseek(orderHistory, 0, SEEK_END);
+    long records = ftell(orderHistory) / sizeof(ORDER);
+
+    int ok = 0;
+    FILE *f = fopen("../data/productIndex.dat", "rb");
+    if (f)
+    {
+        ok = fread(&productIndex.recordCount, sizeof(long), 1, f) == 1 &&
+             fread(&productIndex.count, sizeof(long), 1, f) == 1 &&
+             fread(&productIndex.postingsSize, sizeof(long), 1, f) == 1 &&
+             productIndex.recordCount <= records && productIndex.count >= 0 && productIndex.postingsSize >= 0;
+        if (ok)
+        {
+            productIndex.entries = malloc((productIndex.count + 1) * sizeof(PRODUCT_ENTRY));
+            productIndex.postings = malloc(productIndex.postingsSize + 1);
+            ok = fread(productIndex.entries, sizeof(PRODUCT_ENTRY), productIndex.count, f) == (size_t)productIndex.count &&
+                 fread(productIndex.postings, 1, productIndex.postingsSize, f) == (size_t)productIndex.postingsSize;
+        }
+        fclose(f);
+    }
+
+    FILE *log = ok ? fopen("../data/productIndex.log", "rb") : NULL;
+    if (log)
+    {
+        PRODUCT_POSTING posting;
+        while (fread(&posting, sizeof(PRODUCT_POSTING), 1, log) == 1)
+            addProductPosting(&productIndex, posting.product_id, posting.location);
+        fclose(log);
+
+        productIndex.log = productIndex.pending;
+        productIndex.logCount = productIndex.pendingCount;
+        productIndex.pending = NULL;
+        productIndex.pendingCount = 0;
+        productIndex.pendingCapacity = 0;
+    }
+
+    if (!ok)
+        rebuildProductIndex(orderHistory, orderOverflow);
+}
+
+// RESPONDE: Quanto vendeu o produto X? Le so os registros da lista do produto
+void showProductSales(FILE *orderHistory, FILE *orderOverflow, long long product_id)
+{
+    printf("\n=== VENDAS DO PRODUTO %lld ===\n", product_id);
+    char date[DATE_TEXT_SIZE];
+
+    long left = 0, right = productIndex.count - 1;
+    PRODUCT_ENTRY *entry = NULL;
+    while (left <= right)
+    {
+        long middle = left + (right - left) / 2;
+        if (productIndex.entries[middle].product_id == product_id)
+        {
+            entry = &productIndex.entries[middle];
+            break;
+        }
+        if (productIndex.entries[middle].product_id < product_id)
+            left = middle + 1;
+        else
+            right = middle - 1;
+    }
+
+    long sales = 0, units = 0;
+    double revenue = 0;
+    ORDER order;
+
+    // Insercoes nas paginas deslocam registros e registram a nova posicao no log: as posicoes do
+    // arquivo principal sao unificadas e cada registro lido so conta se ainda for do produto
+    long candidateCount = 0;
+    long *candidates = malloc(((entry ? entry->count : 0) + productIndex.logCount + 1) * sizeof(long));
+    const unsigned char *ptr = entry ? productIndex.postings + entry->offset : NULL;
+    long record = 0;
+    for (long i = 0; entry && i < entry->count; i++)
+    {
+        record += decodeVarint(&ptr);
+        candidates[candidateCount++] = record;
+    }
+    for (long i = 0; i < productIndex.logCount; i++)
+    {
+        if (productIndex.log[i].product_id == product_id && productIndex.log[i].location >= 0)
+            candidates[candidateCount++] = productIndex.log[i].location;
+    }
+    qsort(candidates, candidateCount, sizeof(long), compareLongs);
+
+    for (long i = 0; i < candidateCount; i++)
+    {
+        if (i > 0 && candidates[i] == candidates[i - 1])
+            continue;
+        fseek(orderHistory, candidates[i] * sizeof(ORDER), SEEK_SET);
+        if (fread(&order, sizeof(ORDER), 1, orderHistory) != 1 || isOrderRemoved(&order) ||
+            order.product_id != product_id)
+            continue;
+
+        sales++;
+        units += order.quantity;
+        revenue += centsToUsd(order.price_cents) * order.quantity;
+        if (sales <= 10)
+            printf("  Ordem %lld  %s  qtd %d  $%.2f\n", order.order_id, formatDateTime(order.date, date),
+                   order.quantity, centsToUsd(order.price_cents));
+    }
+    free(candidates);
+
+    for (long i = 0; i < productIndex.logCount; i++)
+    {
+        PRODUCT_POSTING *posting = &productIndex.log[i];
+        if (posting->product_id != product_id || posting->location >= 0)
+            continue;
+
+        OVERFLOW_RECORD overflow;
+        fseek(orderOverflow, -(posting->location + 1), SEEK_SET);
+        if (fread(&overflow, sizeof(OVERFLOW_RECORD), 1, orderOverflow) != 1)
+            continue;
+        order = overflow.record;
+        if (isOrderRemoved(&order))
+            continue;
+
+        sales++;
+        units += order.quantity;
+        revenue += centsToUsd(order.price_cents) * order.quantity;
+        if (sales <= 10)
+            printf("  Ordem %lld  %s  qtd %d  $%.2f\n", order.order_id, formatDateTime(order.date, date),
+                   order.quantity, centsToUsd(order.price_cents));
+    }
+
+    if (sales > 10)
+        printf("  ... mais %ld vendas\n", sales - 10);
+    printf("Vendas: %ld  Unidades: %ld  Receita: $%.2f\n", sales, units, revenue);
+}
+
+// PERGUNTA: Qual a joia mais vendida? ----------------------------------------------------------------
+unsigned long hash(long long int product_id)
+{
+    return product_id % HASH_SIZE;
+}
+
+// Soma quantity ao produto na hash; 1 se o produto era novo
+int addProductQuantity(HashNode **hashTable, long long product_id, int quantity)
+{
+    unsigned long idx = hash(product_id);
+    for (HashNode *current = hashTable[idx]; current; current = current->next)
+    {
+        if (current->product_id == product_id)
+        {
+            current->total_quantity += quantity;
+            return 0;
+        }
+    }
+
+    HashNode *newNode = malloc(sizeof(HashNode));
+    newNode->product_id = product_id;
+    newNode->total_quantity = quantity;
+    newNode->next = hashTable[idx];
+    hashTable[idx] = newNode;
+    return 1;
+}
+
+void contMostSoldJewel(FILE *orderHistory, FILE *jewelryRegister, FILE *jewelryIndex, int indexGap)
+{
+    printf("\n=== PRODUTO MAIS VENDIDO ===\n");
+
+    HashNode **hashTable = calloc(HASH_SIZE, sizeof(HashNode *));
+    if (!hashTable)
+    {
+        printf("Erro ao alocar hash table.\n");
+        return;
+    }
+
+    fseek(orderHistory, 0, SEEK_END);
+    long totalOrders = ftell(orderHistory) / sizeof(ORDER);
+
+    printf("Processando %ld pedidos...\n", totalOrders);
+
+    ORDER order;
+    fseek(orderHistory, 0, SEEK_SET);
+    int uniqueProducts = 0;
+
+    // Modo colunar: so product_id, quantity e status (13 bytes por registro)
+    const long CHUNK = 16384;
+    char *status = columnStore.isOpen ? malloc(CHUNK) : NULL;
+    long long *products = columnStore.isOpen ? malloc(CHUNK * sizeof(long long)) : NULL;
+    int *quantities = columnStore.isOpen ? malloc(CHUNK * sizeof(int)) : NULL;
+
+    for (long first = 0; columnStore.isOpen && first < totalOrders; first += CHUNK)
+    {
+        long count = readColumn(&columnStore, COLUMN_STATUS, first, CHUNK, status);
+        readColumn(&columnStore, COLUMN_PRODUCT, first, count, products);
+        readColumn(&columnStore, COLUMN_QUANTITY, first, count, quantities);
+
+        for (long i = 0; i < count; i++)
+        {
+            if (status[i])
+                uniqueProducts += addProductQuantity(hashTable, products[i], quantities[i]);
+        }
+        printf("  %ld pedidos...\r", first + count);
+        fflush(stdout);
+    }
+    free(status);
+    free(products);
+    free(quantities);
+
+    for (long i = 0; i < totalOrders && !columnStore.isOpen; i++)
+    {
+        if (fread(&order, sizeof(ORDER), 1, orderHistory) != 1)
+            break;
+        if (isOrderRemoved(&order))
+            continue;
+
+        uniqueProducts += addProductQuantity(hashTable, order.product_id, order.quantity);
+
+        if ((i + 1) % 10000 == 0)
+        {
+            printf("  %ld pedidos...\r", i + 1);
+            fflush(stdout);
+        }
+    }
+
+    printf("\nProdutos unicos: %d\n", uniqueProducts);
+
+    PRODUCT_SALES *sales = malloc(uniqueProducts * sizeof(PRODUCT_SALES));
+    int count = 0;
+
+    for (int i = 0; i < HASH_SIZE; i++)
+    {
+        HashNode *current = hashTable[i];
+        while (current)
+        {
+            sales[count].product_id = current->product_id;
+            sales[count].total_quantity = current->total_quantity;
+            count++;
+            HashNode *temp = current;
+            current = current->next;
+            free(temp);
+        }
+    }
+    free(hashTable);
+
+    quicksort(sales, count, sizeof(PRODUCT_SALES), compareSales);
+
+    printf("\n=== TOP 10 ===\n");
+    printf("%-4s %-20s %-12s %-10s %-10s %-10s\n",
+           "Pos", "Product ID", "Quantidade", "Cor", "Metal", "Gema");
+    printf("----------------------------------------------------------------\n");
+
+    int limit = (count < 10) ? count : 10;
+    long long topIds[10] = {0};
+    JEWELRY top[10];
+    int topFound[10];
+    for (int i = 0; i < limit; i++)
+        topIds[i] = sales[i].product_id;
+    searchJewelryBatch(jewelryRegister, jewelryIndex, topIds, limit, top, topFound, indexGap);
+
+    for (int i = 0; i < limit; i++)
+    {
+        if (topFound[i])
+        {
+            printf("%-4d %-20lld %-12d %-10s %-10s %-10s\n",
+                   i + 1, sales[i].product_id, sales[i].total_quantity,
+                   dictionaryValue(DICT_COLOR, top[i].color), dictionaryValue(DICT_METAL, top[i].metal),
+                   dictionaryValue(DICT_GEM, top[i].gem));
+        }
+    }
+    printf("----------------------------------------------------------------\n\n");
+
+    free(sales);
+}
+
+
+// ----------------------------- Reconstruir Index ----------------------------------
+int rebuildOrderIndex(FILE *orderHistory, FILE *orderIndex, FILE *orderOverflow, int indexGap)
+{
+    fseek(orderHistory, 0, SEEK_END);
+    long totalRecords = ftell(orderHistory) / sizeof(ORDER);
+    fseek(orderIndex, 0, SEEK_SET); // Limpa o índice
+
+    ORDER order;
+    int indexCount = 0;
+
+    // Uma entrada por pagina: removidos e slots livres guardam a chave, entao o primeiro slot serve
+    for (long i = 0; i < totalRecords; i += indexGap)
+    {
+        long currentPos = i * sizeof(ORDER);
+        fseek(orderHistory, currentPos, SEEK_SET);
+        if (fread(&order, sizeof(ORDER), 1, orderHistory) != 1)
+            break;
+
+        INDEX indexEntry = {order.order_id, currentPos};
+        fwrite(&indexEntry, sizeof(INDEX), 1, orderIndex);
+        indexCount++;
+    }
+
+    fflush(orderIndex);
+    ftruncate(fileno(orderIndex), indexCount * sizeof(INDEX));
+    reloadSparseIndex(&orderSparse, orderIndex);
+    if (overflowChains.isOpen)
+    {
+        relinkOverflowChains(&overflowChains, orderIndex);
+        rebuildOrderBloom(orderHistory, indexGap);
+        rebuildOrderZones(orderHistory);
+    }
+    // Posicoes atuais direto nas listas do indice de produtos; o log volta a ter so o overflow
+    rebuildProductIndex(orderHistory, orderOverflow);
+
+    return indexCount;
+}
+
+int rebuildJewelryIndex(FILE *jewelryRegister, FILE *jewelryIndex, int indexGap)
+{
+    fseek(jewelryRegister, 0, SEEK_END);
+    long totalRecords = ftell(jewelryRegister) / sizeof(JEWELRY);
+
+    if (totalRecords == 0)
+    {
+        printf("Arquivo de joias vazio. Nao ha indice para reconstruir.\n");
+        return 0;
+    }
+
+    fseek(jewelryIndex, 0, SEEK_SET);
+
+    JEWELRY jewelry;
+    int indexCount = 0;
+
+    fseek(jewelryRegister, 0, SEEK_SET);
+
+    for (long i = 0; i < totalRecords; i++)
+    {
+        long currentPos = ftell(jewelryRegister);
+
+        if (fread(&jewelry, sizeof(JEWELRY), 1, jewelryRegister) != 1)
+        {
+            printf("Erro ao ler registro %ld\n", i);
+            break;
+        }
+
+        if (i % indexGap == 0)
+        {
+            INDEX indexEntry = {
+                jewelry.product_id,
+                currentPos};
+            fwrite(&indexEntry, sizeof(INDEX), 1, jewelryIndex);
+            indexCount++;
+        }
+    }
+
+    long newIndexSize = indexCount * sizeof(INDEX);
+    fflush(jewelryIndex);
+
+#ifdef _WIN32
+    _chsize(_fileno(jewelryIndex), newIndexSize);
+#else
+    ftruncate(fileno(jewelryIndex), newIndexSize);
+#endif
+    reloadSparseIndex(&jewelrySparse, jewelryIndex);
+
+    printf("Indice de joias reconstruido com sucesso: %d entradas.\n", indexCount);
+    return indexCount;
+}
+
+void rebuildCategoryData(FILE *orderHistory, FILE *categoryRegister,
+                         FILE *categoryIndex, int indexGap)
+{
+    printf("\n=== RECONSTRUINDO DADOS DE CATEGORIAS ===\n");
+
+    // Hash table para agregação
+    CategoryNode **categoryHash = calloc(1000, sizeof(CategoryNode *));
+
+    fseek(orderHistory, 0, SEEK_END);
+    long totalOrders = ftell(orderHistory) / sizeof(ORDER);
+    fseek(orderHistory, 0, SEEK_SET);
+
+    printf("Processando %ld pedidos...\n", totalOrders);
+
+    ORDER order;
+    for (long i = 0; i < totalOrders; i++)
+    {
+        if (fread(&order, sizeof(ORDER), 1, orderHistory) != 1)
+            break;
+        if (isOrderFree(&order))
+            continue;
+
+        addCategorySale(categoryHash, &order);
+
+        if ((i + 1) % 10000 == 0)
+        {
+            printf("  %ld pedidos...\r", i + 1);
+            fflush(stdout);
+        }
+    }
+
+    printf("\n");
+
+    int categoryCount = 0;
+    CATEGORY *categories = malloc(1000 * sizeof(CATEGORY));
+
+    for (int i = 0; i < 1000; i++)
+    {
+        CategoryNode *current = categoryHash[i];
+        while (current)
+        {
+            categories[categoryCount].category_id = current->data.category_id;
+            strncpy(categories[categoryCount].category_alias, current->data.category_alias,
+                    sizeof(categories[categoryCount].category_alias) - 1);
+            categories[categoryCount].product_count = current->data.product_count;
+            categories[categoryCount].total_sales = current->data.total_sales;
+            categories[categoryCount].total_revenue = current->data.total_revenue;
+            categoryCount++;
+
+            CategoryNode *temp = current;
+            current = current->next;
+            free(temp);
+        }
+    }
+
+    sortRecordsByKey(categories, categoryCount, sizeof(CATEGORY), offsetof(CATEGORY, category_id));
+
+    fseek(categoryRegister, 0, SEEK_SET);
+    fseek(categoryIndex, 0, SEEK_SET);
+
+    for (int i = 0; i < categoryCount; i++)
+    {
+        long pos = i * sizeof(CATEGORY);
+        fwrite(&categories[i], sizeof(CATEGORY), 1, categoryRegister);
+
+        if (i % indexGap == 0)
+        {
+            INDEX indexEntry = {categories[i].category_id, pos};
+            fwrite(&indexEntry, sizeof(INDEX), 1, categoryIndex);
+        }
+    }
+
+    ftruncate(fileno(categoryRegister), categoryCount * sizeof(CATEGORY));
+    ftruncate(fileno(categoryIndex), ((categoryCount + indexGap - 1) / indexGap) * sizeof(INDEX));
+
+    fflush(categoryRegister);
+    fflush(categoryIndex);
+    reloadSparseIndex(&categorySparse, categoryIndex);
+
+    free(categories);
+    free(categoryHash);
+
+    printf("Categorias reconstruidas: %d registros\n\n", categoryCount);
+}
+
+void rebuildAllIndices(FILE *orderHistory, FILE *orderIndex, FILE *orderOverflow, FILE *categoryRegister,
+                       FILE *categoryIndex, int indexGap)
+{
+
+    printf("\n\n=============== REORGANIZACAO GERAL DO SISTEMA ===============\n");
+
+    rebuildOrderIndex(orderHistory, orderIndex, orderOverflow, indexGap);
+    rebuildCategoryData(orderHistory, categoryRegister, categoryIndex, indexGap);
+
+    removal_count = 0;
+
+    printf("==============================================================\n");
+    printf("TODOS OS INDICES E DADOS DE CADASTRO FORAM RECONSTRUIDOS.\n\n");
+}
+
+void showOrderHistory(FILE *orderHistory)
+{
+    fseek(orderHistory, 0, SEEK_END);
+    long total = ftell(orderHistory) / sizeof(ORDER);
+
+    printf("\nTotal registros: %ld\n", total);
+
+    ORDER order;
+    char date[DATE_TEXT_SIZE];
+    fseek(orderHistory, 0, SEEK_SET);
+
+    // Slots livres das paginas nao sao ordens
+    printf("\nPrimeiros 5:\n");
+    int shown = 0;
+    for (long i = 0; shown < 5 && i < total; i++)
+    {
+        if (fread(&order, sizeof(ORDER), 1, orderHistory) == 1 && !isOrderFree(&order))
+        {
+            printf("%ld. ID: %lld, Data: %s\n", i + 1, order.order_id, formatDateTime(order.date, date));
+            shown++;
+        }
+    }
+
+    printf("\nUltimos 5:\n");
+    long last[5];
+    shown = 0;
+    for (long i = total - 1; shown < 5 && i >= 0; i--)
+    {
+        fseek(orderHistory, i * sizeof(ORDER), SEEK_SET);
+        if (fread(&order, sizeof(ORDER), 1, orderHistory) == 1 && !isOrderFree(&order))
+            last[shown++] = i;
+    }
+
+    for (int i = shown - 1; i >= 0; i--)
+    {
+        fseek(orderHistory, last[i] * sizeof(ORDER), SEEK_SET);
+        if (fread(&order, sizeof(ORDER), 1, orderHistory) == 1)
+        {
+            printf("%ld. ID: %lld, Data: %s\n", last[i] + 1, order.order_id, formatDateTime(order.date, date));
+        }
+    }
+    printf("\n");
+}
+
+// RESPONDE: Quais itens tem a ordem X (ou as ordens de lo a hi)?
+void showOrderRange(FILE *orderHistory, FILE *orderIndex, FILE *orderOverflow, long long lo, long long hi)
+{
+    ORDER_CURSOR cursor;
+    openOrderCursor(&cursor, orderHistory, orderIndex, orderOverflow, lo, hi);
+
+    long items = 0, units = 0;
+    double revenue = 0;
+    ORDER *order;
+    char date[DATE_TEXT_SIZE];
+
+    printf("\n");
+    while ((order = orderCursorNext(&cursor)) != NULL)
+    {
+        if (items < 50)
+            printf("%lld | %s | Produto %lld | Qtd %d | $%.2f\n", order->order_id, formatDateTime(order->date, date),
+                   order->product_id, order->quantity, centsToUsd(order->price_cents));
+        items++;
+        units += order->quantity;
+        revenue += centsToUsd(order->price_cents) * order->quantity;
+    }
+    closeOrderCursor(&cursor);
+
+    if (items > 50)
+        printf("... (%ld itens nao exibidos)\n", items - 50);
+    printf("\nItens: %ld  Unidades: %ld  Receita: $%.2f\n\n", items, units, revenue);
+}
+
+void showJewelryRegister(FILE *jewelryRegister)
+{
+    fseek(jewelryRegister, 0, SEEK_END);
+    long total = ftell(jewelryRegister) / sizeof(JEWELRY);
+
+    printf("\nTotal joias: %ld\n", total);
+
+    JEWELRY jewelry;
+    fseek(jewelryRegister, 0, SEEK_SET);
+
+    printf("\nPrimeiras 5:\n");
+    for (int i = 0; i < 5 && i < total; i++)
+    {
+        if (fread(&jewelry, sizeof(JEWELRY), 1, jewelryRegister) == 1)
+        {
+            printf("%d. Product ID: %lld, Cor: %s\n", i + 1, jewelry.product_id, dictionaryValue(DICT_COLOR, jewelry.color));
+        }
+    }
+    printf("\n");
+}
+
+void showFileStats(FILE *orderHistory, FILE *orderOverflow)
+{
+    printf("\n=== ESTATISTICAS ===\n");
+
+    fseek(orderHistory, 0, SEEK_END);
+    long totalRecords = ftell(orderHistory) / sizeof(ORDER);
+
+    ORDER order;
+    int active = 0, removed = 0, freeSlots = 0;
+
+    fseek(orderHistory, 0, SEEK_SET);
+    for (long i = 0; i < totalRecords; i++)
+    {
+        if (fread(&order, sizeof(ORDER), 1, orderHistory) != 1)
+            break;
+        if (isOrderFree(&order))
+            freeSlots++;
+        else if (isOrderRemoved(&order))
+            removed++;
+        else
+            active++;
+    }
+
+    int overflowCount = 0;
+    if (orderOverflow)
+    {
+        fseek(orderOverflow, 0, SEEK_END);
+        overflowCount = ftell(orderOverflow) / sizeof(OVERFLOW_RECORD);
+    }
+
+    printf("Registros totais:    %ld\n", totalRecords);
+    printf("Registros ativos:    %d (%.1f%%)\n", active, (active * 100.0) / totalRecords);
+    printf("Registros removidos: %d (%.1f%%)\n", removed, (removed * 100.0) / totalRecords);
+    printf("Slots livres:        %d (%.1f%%)\n", freeSlots, (freeSlots * 100.0) / totalRecords);
+    printf("Registros overflow:  %d\n", overflowCount);
+    printf("Tamanho arquivo:     %.2f MB\n", (totalRecords * sizeof(ORDER)) / (1024.0 * 1024.0));
+
+    if (overflowCount > totalRecords * 0.05)
+    {
+        printf("\nAVISO: Muitos registros em overflow (>5%%)\n");
+        printf("Recomenda-se reorganizar o arquivo!\n");
+    }
+    printf("\n");
+}
+
+int removeOrder(FILE *orderHistory, FILE *orderIndex, FILE *orderOverflow,
+                long long int target_id, int indexGap)
+{
+    ORDER *order = searchOrderById(orderHistory, orderIndex, orderOverflow, target_id, indexGap);
+
+    if (!order)
+    {
+        printf("Ordem nao encontrada.\n");
+        return 0;
+    }
+
+    char date[DATE_TEXT_SIZE];
+    printf("Ordem encontrada:\n");
+    printf("  Order ID: %lld\n", order->order_id);
+    printf("  Data: %s\n", formatDateTime(order->date, date));
+    printf("  Quantidade: %d\n", order->quantity);
+    printf("  Preco: %.2f USD\n", centsToUsd(order->price_cents));
+
+    printf("\nConfirma remocao? (s/n): ");
+    char confirm;
+    scanf(" %c", &confirm);
+
+    if (confirm != 's' && confirm != 'S')
+    {
+        printf("Remocao cancelada.\n");
+        free(order);
+        return 0;
+    }
+
+    order->status = REMOVED_FLAG;
+
+    long pos = findOrderPosition(orderHistory, orderIndex, target_id, indexGap);
+    int found = (pos >= 0);
+
+    if (found)
+    {
+        fseek(orderHistory, pos, SEEK_SET);
+        fwrite(order, sizeof(ORDER), 1, orderHistory);
+        fflush(orderHistory);
+        writeColumns(&columnStore, pos / sizeof(ORDER), order, 1);
+        orderBitmapsRemove(pos / sizeof(ORDER));
+    }
+    else
+    {
+        if (orderOverflow)
+        {
+            OVERFLOW_RECORD overflow;
+            long overflowPos = findOverflowRecord(orderOverflow, orderBlockOf(orderIndex, target_id),
+                                                  target_id, &overflow);
+            if (overflowPos >= 0)
+            {
+                overflow.record.status = REMOVED_FLAG;
+                fseek(orderOverflow, overflowPos, SEEK_SET);
+                fwrite(&overflow, sizeof(OVERFLOW_RECORD), 1, orderOverflow);
+                fflush(orderOverflow);
+                orderBitmapsRemove(ROARING_OVERFLOW_BASE + overflowPos / sizeof(OVERFLOW_RECORD));
+                found = 1;
+            }
+        }
+    }
+
+    free(order);
+
+    if (found)
+    {
+        printf("Ordem removida com sucesso.\n");
+        removal_count++;
+
+        if (removal_count >= REBUILD_THRESHOLD)
+        {
+            printf("\nReconstruindo indice automaticamente...\n");
+            rebuildOrderIndex(orderHistory, orderIndex, orderOverflow, indexGap);
+            removal_count = 0;
+        }
+        return 1;
+    }
+    else
+    {
+        printf("Erro ao localizar ordem para remocao.\n");
+        return 0;
+    }
+}
+
+void listOverflowRecords(FILE *orderOverflow)
+{
+    if (!orderOverflow)
+    {
+        printf("Arquivo de overflow nao disponivel.\n");
+        return;
+    }
+
+    printf("\n=== REGISTROS EM OVERFLOW ===\n");
+
+    fseek(orderOverflow, 0, SEEK_END);
+    long total = ftell(orderOverflow) / sizeof(OVERFLOW_RECORD);
+
+    if (total == 0)
+    {
+        printf("Nenhum registro em overflow.\n\n");
+        return;
+    }
+
+    printf("Total: %ld registros\n\n", total);
+    printf("%-20s %-15s %-12s\n", "Order ID", "Product ID", "Quantidade");
+    printf("---------------------------------------------------\n");
+
+    OVERFLOW_RECORD overflow;
+    fseek(orderOverflow, 0, SEEK_SET);
+    int count = 0;
+
+    while (fread(&overflow, sizeof(OVERFLOW_RECORD), 1, orderOverflow) == 1)
+    {
+        if (!isOrderRemoved(&overflow.record))
+        {
+            printf("%-20lld %-15lld %-12d\n",
+                   overflow.record.order_id,
+                   overflow.record.product_id,
+                   overflow.record.quantity);
+            count++;
+        }
+    }
+
+    printf("---------------------------------------------------\n");
+    printf("Total ativos: %d\n\n", count);
+}
+
+
+// RESPONDE: Qual o mês com mais vendas -------------------------------------------------
+// Ano e mes da data; 0 se invalida ou fora de 2018-2025
+int dateYearMonth(long long date, int *year, int *month)
+{
+    if (date < 0)
+        return 0;
+
+    civilFromDays(date / 86400, year, month);
+    return *year >= 2018 && *year <= 2025;
+}
+
+const char *getMonthName(int month)
+{
+    static const char *months[] = {
+        "Janeiro", "Fevereiro", "Março", "Abril", "Maio", "Junho",
+        "Julho", "Agosto", "Setembro", "Outubro", "Novembro", "Dezembro"};
+
+    if (month < 1 || month > 12)
+        return "Inválido";
+    return months[month - 1];
+}
+
+// Mesmo acumulo de findBestMonth lendo so status, data, quantity e preco
+void monthSalesColumnar(long totalOrders, int *month_qty, int *month_orders, float *month_revenue)
+{
+    const long CHUNK = 16384;
+    char *status = malloc(CHUNK);
+    long long *dates = malloc(CHUNK * sizeof(long long));
+    int *quantities = malloc(CHUNK * sizeof(int));
+    int *prices = malloc(CHUNK * sizeof(int));
+
+    for (long first = 0; first < totalOrders; first += CHUNK)
+    {
+        long count = readColumn(&columnStore, COLUMN_STATUS, first, CHUNK, status);
+        readColumn(&columnStore, COLUMN_DATE, first, count, dates);
+        readColumn(&columnStore, COLUMN_QUANTITY, first, count, quantities);
+        readColumn(&columnStore, COLUMN_PRICE, first, count, prices);
+
+        for (long i = 0; i < count; i++)
+        {
+            int year, month;
+            if (!status[i] || !dateYearMonth(dates[i], &year, &month))
+                continue;
+
+            month_qty[month - 1] += quantities[i];
+            month_orders[month - 1]++;
+            month_revenue[month - 1] += (centsToUsd(prices[i]) * quantities[i]);
+        }
+    }
+
+    free(status);
+    free(dates);
+    free(quantities);
+    free(prices);
+}
+
+void findBestMonth(FILE *orderHistory)
+{
+    fseek(orderHistory, 0, SEEK_END);
+    long totalOrders = ftell(orderHistory) / sizeof(ORDER);
+
+    if (totalOrders == 0)
+    {
+        printf("Arquivo de ordens vazio.\n\n");
+        return;
+    }
+
+    int month_qty[12] = {0};
+    int month_orders[12] = {0};
+    float month_revenue[12] = {0.0};
+
+    ORDER order;
+    fseek(orderHistory, 0, SEEK_SET);
+
+    if (columnStore.isOpen)
+        monthSalesColumnar(totalOrders, month_qty, month_orders, month_revenue);
+
+    for (long i = 0; i < totalOrders && !columnStore.isOpen; i++)
+    {
+        if (fread(&order, sizeof(ORDER), 1, orderHistory) != 1)
+            break;
+
+        if (isOrderRemoved(&order))
+            continue;
+
+        int year, month;
+
+        if (dateYearMonth(order.date, &year, &month))
+        {
+            int idx = month - 1;
+
+            month_qty[idx] += order.quantity;
+            month_orders[idx]++;
+            month_revenue[idx] += (centsToUsd(order.price_cents) * order.quantity);
+        }
+    }
+
+    int best_month_index = 0;
+    for (int i = 1; i < 12; i++)
+    {
+        if (month_qty[i] > month_qty[best_month_index])
+        {
+            best_month_index = i;
+        }
+    }
+
+    printf("\n========================================\n");
+    printf(" RESPOSTA: MES MAIS VENDIDO\n");
+    printf("========================================\n");
+
+    if (month_orders[best_month_index] == 0)
+    {
+        printf("Nenhum dado de vendas valido encontrado.\n\n");
+        return;
+    }
+
+    printf("O mes em que mais se vende joias e:\n\n");
+    printf(" >>> %s <<<\n\n", getMonthName(best_month_index + 1));
+
+    printf("Estatisticas Agregadas:\n");
+    printf("Total de Pedidos: %d\n", month_orders[best_month_index]);
+    printf("Unidades Vendidas: %d\n", month_qty[best_month_index]);
+    printf("Receita Total: $%.2f\n", month_revenue[best_month_index]);
+    printf("========================================\n\n");
+}
+
+
+// Refaz as colunas lendo orderHistory.dat
+void rebuildColumns(FILE *orderHistory)
+{
+    if (!openColumnStore(&columnStore, 1))
+        return;
+
+    ORDER *buffer = malloc(RUN_READ_BUFFER);
+    long perRead = RUN_READ_BUFFER / sizeof(ORDER), first = 0, count;
+    fflush(orderHistory);
+    fseek(orderHistory, 0, SEEK_SET);
+    while ((count = fread(buffer, sizeof(ORDER), perRead, orderHistory)) > 0)
+    {
+        writeColumns(&columnStore, first, buffer, count);
+        first += count;
+    }
+    free(buffer);
+}
+
+// Abre as colunas (com --columnar) conferindo o tamanho de cada uma; sem a opcao, descarta-as
+void loadColumnStore(FILE *orderHistory)
+{
+    if (!config.columnar)
+    {
+        closeColumnStore(&columnStore);
+        invalidateColumns(&columnStore);
+        return;
+    }
+
+    fseek(orderHistory, 0, SEEK_END);
+    long records = ftell(orderHistory) / sizeof(ORDER);
+
+    int ok = openColumnStore(&columnStore, 0);
+    for (int c = 0; ok && c < COLUMN_COUNT; c++)
+    {
+        fseek(columnStore.files[c], 0, SEEK_END);
+        ok = ftell(columnStore.files[c]) == records * (long)columnWidths[c];
+    }
+
+    if (!ok)
+        rebuildColumns(orderHistory);
+    printf("Modo colunar: %d colunas de %ld registros\n", COLUMN_COUNT, records);
+}
+
+// ------------------------------ Consulta com filtros (zone maps) ------------------------------
+
+int zoneMatches(ZONE_MAP *zone, ORDER_FILTER *filter)
+{
+    if (zone->maxDate < filter->fromDate || zone->minDate > filter->toDate)
+        return 0;
+    if (filter->category_id && (filter->category_id < zone->minCategory || filter->category_id > zone->maxCategory))
+        return 0;
+    if (zone->maxPrice < filter->minPrice || zone->minPrice > filter->maxPrice)
+        return 0;
+    return 1;
+}
+
+int orderMatches(ORDER *order, ORDER_FILTER *filter)
+{
+    if (isOrderRemoved(order))
+        return 0;
+
+    if (order->date < filter->fromDate || order->date > filter->toDate)
+        return 0;
+    if (filter->category_id && order->category_id != filter->category_id)
         return 0;
+    float price = centsToUsd(order->price_cents);
+    return price >= filter->minPrice && price <= filter->maxPrice;
+}
+
+// RESPONDE: Quanto se vendeu em um periodo / categoria / faixa de preco?
+void scanOrdersWithFilter(FILE *orderHistory, FILE *orderOverflow, ORDER_FILTER *filter)
+{
+    if (!orderSparse.entries || orderZones.count < orderSparse.count)
+    {
+        printf("Zone maps indisponiveis (indice de ordens nao residente).\n");
+        return;
+    }
+
+    fseek(orderHistory, 0, SEEK_END);
+    long fileSize = ftell(orderHistory);
+
+    long matches = 0, units = 0, skipped = 0;
+    double revenue = 0;
+
+    for (long b = 0; b < orderSparse.count; b++)
+    {
+        if (!zoneMatches(&orderZones.zones[b], filter))
+        {
+            skipped++;
+            continue;
+        }
+
+        long start = orderSparse.entries[b].position;
+        long end = (b + 1 < orderSparse.count) ? orderSparse.entries[b + 1].position : fileSize;
+        long count;
+        ORDER *block = (ORDER *)readBlock(orderHistory, start, (end - start) / sizeof(ORDER), sizeof(ORDER), &count);
+
+        for (long i = 0; i < count; i++)
+        {
+            if (orderMatches(&block[i], filter))
+            {
+                matches++;
+                units += block[i].quantity;
+                revenue += centsToUsd(block[i].price_cents) * block[i].quantity;
+            }
+        }
+
+        OVERFLOW_RECORD overflow;
+        for (long offset = overflowHead(&overflowChains, start); offset >= 0; offset = overflow.nextOverflow)
+        {
+            fseek(orderOverflow, offset, SEEK_SET);
+            if (fread(&overflow, sizeof(OVERFLOW_RECORD), 1, orderOverflow) != 1)
+                break;
+            if (orderMatches(&overflow.record, filter))
+            {
+                matches++;
+                units += overflow.record.quantity;
+                revenue += centsToUsd(overflow.record.price_cents) * overflow.record.quantity;
+            }
+        }
+    }
+
+    printf("\nBlocos lidos: %ld de %ld (%ld pulados pelas zone maps)\n",
+           orderSparse.count - skipped, orderSparse.count, skipped);
+    printf("Pedidos: %ld  Unidades: %ld  Receita: $%.2f\n\n", matches, units, revenue);
+}
+
+// Le os filtros do usuario; "-" ou 0 deixa o filtro aberto
+void readOrderFilter(ORDER_FILTER *filter)
+{
+    char text[32];
+
+    filter->fromDate = LLONG_MIN;
+    filter->toDate = LLONG_MAX;
+    filter->category_id = 0;
+    filter->minPrice = -1e30f;
+    filter->maxPrice = 1e30f;
+
+    printf("Data inicial (AAAA-MM-DD ou -): ");
+    scanf("%31s", text);
+    if (parseDateTime(text) >= 0)
+        filter->fromDate = parseDateTime(text);
+
+    printf("Data final (AAAA-MM-DD ou -): ");
+    scanf("%31s", text);
+    if (parseDateTime(text) >= 0)
+        filter->toDate = parseDateTime(text) + 86399; // Inclui o dia inteiro
+
+    printf("Category ID (0 = todas): ");
+    scanf("%lld", &filter->category_id);
+
+    float price;
+    printf("Preco minimo (-1 = sem limite): ");
+    scanf("%f", &price);
+    if (price >= 0)
+        filter->minPrice = price;
+
+    printf("Preco maximo (-1 = sem limite): ");
+    scanf("%f", &price);
+    if (price >= 0)
+        filter->maxPrice = price;
+}
+
+// ------------------------------ Consulta por atributos (bitmaps) ------------------------------
+
+// Refaz os bitmaps lendo orderHistory.dat e o overflow
+void rebuildOrderBitmaps(FILE *orderHistory, FILE *orderOverflow)
+{
+    freeOrderBitmaps(&orderBitmaps);
+
+    RUN_READER reader;
+    fflush(orderHistory);
+    if (openRunReader(&reader, "../data/orderHistory.dat", sizeof(ORDER)))
+    {
+        ORDER *order;
+        while ((order = runReaderCurrent(&reader)) != NULL)
+        {
+            if (!isOrderRemoved(order))
+                orderBitmapsAdd(&orderBitmaps, order, orderBitmaps.mainCount);
+            orderBitmaps.mainCount++;
+            runReaderAdvance(&reader);
+        }
+        closeRunReader(&reader);
+    }
+
+    OVERFLOW_RECORD overflow;
+    fseek(orderOverflow, 0, SEEK_SET);
+    while (fread(&overflow, sizeof(OVERFLOW_RECORD), 1, orderOverflow) == 1)
+    {
+        if (!isOrderRemoved(&overflow.record))
+            orderBitmapsAdd(&orderBitmaps, &overflow.record, ROARING_OVERFLOW_BASE + orderBitmaps.overflowCount);
+        orderBitmaps.overflowCount++;
     }
 
-    order->data[0] = REMOVED_FLAG;
+    saveOrderBitmaps(&orderBitmaps);
+}
 
-    fseek(orderHistory, 0, SEEK_SET);
-    ORDER temp;
-    long pos = 0;
-    int found = 0;
+// Carrega orderBitmaps.rbm; se nao cobrir exatamente os arquivos atuais, refaz
+void loadOrderBitmaps(FILE *orderHistory, FILE *orderOverflow)
+{
+    freeOrderBitmaps(&orderBitmaps);
+
+    fseek(orderHistory, 0, SEEK_END);
+    long records = ftell(orderHistory) / sizeof(ORDER);
+    fseek(orderOverflow, 0, SEEK_END);
+    long overflowRecords = ftell(orderOverflow) / sizeof(OVERFLOW_RECORD);
 
-    while (fread(&temp, sizeof(ORDER), 1, orderHistory) == 1)
+    int ok = 0;
+    FILE *f = fopen("../data/orderBitmaps.rbm", "rb");
+    if (f)
     {
-        if (temp.order_id == target_id)
+        ok = fread(&orderBitmaps.mainCount, sizeof(long), 1, f) == 1 &&
+             fread(&orderBitmaps.overflowCount, sizeof(long), 1, f) == 1 &&
+             orderBitmaps.mainCount == records && orderBitmaps.overflowCount == overflowRecords &&
+             readRoaring(&orderBitmaps.live, f);
+
+        for (int field = 0; ok && field < BITMAP_FIELDS; field++)
         {
-            found = 1;
-            break;
+            int count;
+            ok = fread(&count, sizeof(int), 1, f) == 1 && count >= 0;
+            for (int v = 0; ok && v < count; v++)
+            {
+                char value[32];
+                ok = fread(value, sizeof(char), 32, f) == 32;
+                value[31] = '\0';
+                ok = ok && readRoaring(&bitmapValue(&orderBitmaps.fields[field], value, 1)->bitmap, f);
+            }
         }
-        pos += sizeof(ORDER);
+        fclose(f);
     }
 
-    if (found)
+    if (!ok)
+        rebuildOrderBitmaps(orderHistory, orderOverflow);
+    orderBitmaps.dirty = 0;
+}
+
+// Uniao dos bitmaps dos valores separados por virgula
+ROARING bitmapForValues(BITMAP_FIELD *field, char *values)
+{
+    ROARING result = {0};
+    for (char *value = strtok(values, ","); value; value = strtok(NULL, ","))
     {
-        fseek(orderHistory, pos, SEEK_SET);
-        fwrite(order, sizeof(ORDER), 1, orderHistory);
-        fflush(orderHistory);
+        BITMAP_VALUE *entry = bitmapValue(field, value, 0);
+        if (entry)
+            roaringApply(&result, &entry->bitmap, ROARING_OR);
+        else
+            printf("  Valor '%s' nao existe\n", value);
     }
-    else
-    {
-        if (orderOverflow)
-        {
-            fseek(orderOverflow, 0, SEEK_SET);
-            OVERFLOW_RECORD overflow;
-            long overflowPos = 0;
+    return result;
+}
 
-            while (fread(&overflow, sizeof(OVERFLOW_RECORD), 1, orderOverflow) == 1)
-            {
-                if (overflow.record.order_id == target_id)
-                {
-                    overflow.record.data[0] = REMOVED_FLAG;
-                    fseek(orderOverflow, overflowPos, SEEK_SET);
-                    fwrite(&overflow, sizeof(OVERFLOW_RECORD), 1, orderOverflow);
-                    fflush(orderOverflow);
-                    found = 1;
-                    break;
-                }
-                overflowPos += sizeof(OVERFLOW_RECORD);
-            }
-        }
+void listBitmapValues(BITMAP_FIELD *field)
+{
+    for (int v = 0; v < field->count; v++)
+    {
+        ROARING active = roaringCombine(&field->values[v].bitmap, &orderBitmaps.live, ROARING_AND);
+        printf("  %-24s %ld\n", field->values[v].value[0] ? field->values[v].value : "(vazio)",
+               roaringCardinality(&active));
+        freeRoaring(&active);
     }
+}
 
-    free(order);
+// RESPONDE: Quantas ordens tem estes atributos? (ex.: aneis de ouro femininos da categoria X)
+void queryOrderBitmaps()
+{
+    char spec[256];
+    ROARING result = roaringCombine(&orderBitmaps.live, &orderBitmaps.live, ROARING_AND);
 
-    if (found)
+    printf("Para cada campo: - = qualquer, v1,v2 = qualquer um deles, !v = exceto, ? = listar valores\n");
+    for (int field = 0; field < BITMAP_FIELDS; field++)
     {
-        printf("Ordem removida com sucesso.\n");
-        removal_count++;
+        printf("%s: ", bitmapFieldNames[field]);
+        scanf("%255s", spec);
 
-        if (removal_count >= REBUILD_THRESHOLD)
+        if (strcmp(spec, "?") == 0)
         {
-            printf("\nReconstruindo indice automaticamente...\n");
-            rebuildOrderIndex(orderHistory, orderIndex, indexGap);
-            removal_count = 0;
+            listBitmapValues(&orderBitmaps.fields[field]);
+            field--;
+            continue;
         }
-        return 1;
-    }
-    else
-    {
-        printf("Erro ao localizar ordem para remocao.\n");
-        return 0;
+        if (strcmp(spec, "-") == 0)
+            continue;
+
+        int negate = spec[0] == '!';
+        ROARING values = bitmapForValues(&orderBitmaps.fields[field], spec + negate);
+        roaringApply(&result, &values, negate ? ROARING_ANDNOT : ROARING_AND);
+        freeRoaring(&values);
     }
+
+    printf("\nOrdens que atendem: %ld de %ld ativas\n\n", roaringCardinality(&result),
+           roaringCardinality(&orderBitmaps.live));
+    freeRoaring(&result);
 }
 
-void listOverflowRecords(FILE *orderOverflow)
+// RESPONDE: Quais destas ordens existem? Le os order_id de um arquivo texto (um por linha)
+void reconcileOrders(FILE *orderHistory, FILE *orderIndex, FILE *orderOverflow, const char *path, int indexGap)
 {
-    if (!orderOverflow)
+    FILE *list = fopen(path, "r");
+    if (!list)
     {
-        printf("Arquivo de overflow nao disponivel.\n");
+        printf("Erro ao abrir o arquivo %s.\n", path);
         return;
     }
 
-    printf("\n=== REGISTROS EM OVERFLOW ===\n");
-
-    fseek(orderOverflow, 0, SEEK_END);
-    long total = ftell(orderOverflow) / sizeof(OVERFLOW_RECORD);
-
-    if (total == 0)
+    long count = 0, capacity = 1024;
+    long long *keys = malloc(capacity * sizeof(long long));
+    long long key;
+    while (fscanf(list, "%lld", &key) == 1)
     {
-        printf("Nenhum registro em overflow.\n\n");
-        return;
+        if (count == capacity)
+        {
+            capacity *= 2;
+            keys = realloc(keys, capacity * sizeof(long long));
+        }
+        keys[count++] = key;
     }
+    fclose(list);
 
-    printf("Total: %ld registros\n\n", total);
-    printf("%-20s %-15s %-12s\n", "Order ID", "Product ID", "Quantidade");
-    printf("---------------------------------------------------\n");
-
-    OVERFLOW_RECORD overflow;
-    fseek(orderOverflow, 0, SEEK_SET);
-    int count = 0;
+    ORDER *results = malloc((count + 1) * sizeof(ORDER));
+    int *found = malloc((count + 1) * sizeof(int));
+    long hits = searchOrdersBatch(orderHistory, orderIndex, orderOverflow, keys, count, results, found, indexGap);
 
-    while (fread(&overflow, sizeof(OVERFLOW_RECORD), 1, orderOverflow) == 1)
+    printf("\nChaves: %ld  Encontradas: %ld  Ausentes: %ld\n", count, hits, count - hits);
+    long shown = 0;
+    for (long i = 0; i < count && shown < 20; i++)
     {
-        if (!isOrderRemoved(&overflow.record))
+        if (!found[i])
         {
-            printf("%-20lld %-15lld %-12d\n",
-                   overflow.record.order_id,
-                   overflow.record.product_id,
-                   overflow.record.quantity);
-            count++;
+            printf("  Ausente: %lld\n", keys[i]);
+            shown++;
         }
     }
+    printf("\n");
 
-    printf("---------------------------------------------------\n");
-    printf("Total ativos: %d\n\n", count);
+    free(keys);
+    free(results);
+    free(found);
 }
 
+// ------------------------------ Manifesto (inicializacao rapida) ------------------------------
+// Ao final de uma carga e ao encerrar o programa, ../data/manifest.dat registra o formato,
+// tamanhos, contagens e checksums dos arquivos. Na abertura, se o manifesto confere com o
+// que esta em disco (e foi fechado corretamente), a reconstrucao a partir do CSV e pulada.
 
-// RESPONDE: Qual o mês com mais vendas -------------------------------------------------
-int parseYearMonth(const char *date_str, int *year, int *month)
+// Descreve o estado atual dos arquivos em disco; retorna 0 se algum arquivo nao existe
+int buildManifest(MANIFEST *manifest, int indexGap)
 {
-    if (strlen(date_str) < 7)
+    long size;
+    memset(manifest, 0, sizeof(MANIFEST));
+
+    manifest->version = MANIFEST_VERSION;
+    manifest->orderSize = sizeof(ORDER);
+    manifest->jewelrySize = sizeof(JEWELRY);
+    manifest->categorySize = sizeof(CATEGORY);
+    manifest->indexSize = sizeof(INDEX);
+    manifest->overflowSize = sizeof(OVERFLOW_RECORD);
+    manifest->indexGap = indexGap;
+
+    struct stat st;
+    if (stat("../data/jewelry.csv", &st) != 0)
+        return 0;
+    manifest->csvSize = st.st_size;
+    manifest->csvMtime = st.st_mtime;
+
+    manifest->checksums[0] = fileChecksum("../data/orderHistory.dat", &size, MANIFEST_SAMPLE_BYTES);
+    manifest->orderCount = size / sizeof(ORDER);
+    if (size < 0)
+        return 0;
+    manifest->checksums[1] = fileChecksum("../data/orderIndex.idx", &size, 0);
+    if (size < 0)
         return 0;
+    manifest->checksums[2] = fileChecksum("../data/jewelryRegister.dat", &size, MANIFEST_SAMPLE_BYTES);
+    manifest->jewelryCount = size / sizeof(JEWELRY);
+    if (size < 0)
+        return 0;
+    manifest->checksums[3] = fileChecksum("../data/jewelryIndex.idx", &size, 0);
+    if (size < 0)
+        return 0;
+    manifest->checksums[4] = fileChecksum("../data/categoryRegister.dat", &size, 0);
+    manifest->categoryCount = size / sizeof(CATEGORY);
+    if (size < 0)
+        return 0;
+    manifest->checksums[5] = fileChecksum("../data/categoryIndex.idx", &size, 0);
+    if (size < 0)
+        return 0;
+    manifest->checksums[6] = fileChecksum("../data/orderOverflow.dat", &size, MANIFEST_SAMPLE_BYTES);
+    manifest->overflowCount = size / sizeof(OVERFLOW_RECORD);
+    if (size < 0)
+        return 0;
+    manifest->checksums[7] = fileChecksum("../data/dictionaries.dat", &size, 0);
+    if (size < 0)
+        return 0;
+
+    return 1;
+}
 
-    char year_str[5] = {0};
-    strncpy(year_str, date_str, 4);
-    *year = atoi(year_str);
+void saveManifest(int indexGap, int clean)
+{
+    MANIFEST manifest;
+    if (!buildManifest(&manifest, indexGap))
+        return;
+    manifest.clean = clean;
 
-    char month_str[3] = {0};
+    FILE *f = fopen("../data/manifest.dat", "wb");
+    if (!f)
+        return;
+    fwrite(&manifest, sizeof(MANIFEST), 1, f);
+    fclose(f);
+}
 
-    month_str[0] = date_str[5];
-    month_str[1] = date_str[6];
-    *month = atoi(month_str);
+// 1 se os arquivos em disco conferem com o manifesto salvo no ultimo encerramento
+int validateManifest(int indexGap)
+{
+    MANIFEST saved;
+    MANIFEST current;
 
-    if (*year < 2018 || *year > 2025 || *month < 1 || *month > 12)
-    {
+    FILE *f = fopen("../data/manifest.dat", "rb");
+    if (!f)
         return 0;
-    }
+    int ok = (fread(&saved, sizeof(MANIFEST), 1, f) == 1);
+    fclose(f);
 
-    return 1;
+    if (!ok || !saved.clean || !buildManifest(&current, indexGap))
+        return 0;
+
+    current.clean = saved.clean;
+    return memcmp(&saved, &current, sizeof(MANIFEST)) == 0;
 }
 
-const char *getMonthName(int month)
+// ------------------------------ Benchmarks ------------------------------
+double elapsedMs(clock_t start)
 {
-    static const char *months[] = {
-        "Janeiro", "Fevereiro", "Março", "Abril", "Maio", "Junho",
-        "Julho", "Agosto", "Setembro", "Outubro", "Novembro", "Dezembro"};
+    return (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
 
-    if (month < 1 || month > 12)
-        return "Inválido";
-    return months[month - 1];
+unsigned long long benchRandom(unsigned long long *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
 }
 
-void findBestMonth(FILE *orderHistory)
+// Compara o quicksort por ponteiro de funcao com o tag sort (introsort e radix) em runs de ordens
+void benchmarkSort()
 {
-    fseek(orderHistory, 0, SEEK_END);
-    long totalOrders = ftell(orderHistory) / sizeof(ORDER);
+    const int rounds = 10;
+    long count = MEMORY_LIMIT;
+    ORDER *original = calloc(count, sizeof(ORDER));
+    ORDER *work = malloc(count * sizeof(ORDER));
+    unsigned long long state = 88172645463325252ULL;
+    const char *cases[] = {"aleatorio", "quase ordenado"};
 
-    if (totalOrders == 0)
+    printf("\n=== BENCHMARK DE ORDENACAO (%ld ordens, %d rodadas) ===\n", count, rounds);
+    printf("%-16s %14s %14s %14s\n", "Entrada", "quicksort", "introsort", "radix");
+
+    for (int c = 0; c < 2; c++)
     {
-        printf("Arquivo de ordens vazio.\n\n");
-        return;
+        for (long i = 0; i < count; i++)
+        {
+            unsigned long long noise = benchRandom(&state);
+            if (c == 0 || noise % 20 == 0)
+                original[i].order_id = 1924719190000000000LL + (long long)(noise % 10000000000ULL);
+            else
+                original[i].order_id = 1924719190000000000LL + i * 1000;
+        }
+
+        double times[3];
+        int sorted = 1;
+        for (int method = 0; method < 3; method++)
+        {
+            clock_t start = clock();
+            for (int r = 0; r < rounds; r++)
+            {
+                memcpy(work, original, count * sizeof(ORDER));
+                if (method == 0)
+                    quicksort(work, count, sizeof(ORDER), compareOrders);
+                else
+                    sortRecordsByKeyUsing(work, count, sizeof(ORDER), offsetof(ORDER, order_id), method == 2);
+            }
+            times[method] = elapsedMs(start) / rounds;
+
+            for (long i = 1; i < count; i++)
+                if (work[i - 1].order_id > work[i].order_id)
+                    sorted = 0;
+        }
+
+        printf("%-16s %11.2f ms %11.2f ms %11.2f ms%s\n", cases[c], times[0], times[1], times[2],
+               sorted ? "" : "  (ERRO: saida fora de ordem)");
     }
+    printf("\n");
 
-    int month_qty[12] = {0};
-    int month_orders[12] = {0};
-    float month_revenue[12] = {0.0};
+    free(original);
+    free(work);
+}
 
-    ORDER order;
-    fseek(orderHistory, 0, SEEK_SET);
+// Compara a busca binaria no vetor de INDEX com o layout de Eytzinger para varios tamanhos de indice
+void benchmarkSearch()
+{
+    const long queries = 2000000;
+    const long sizes[] = {1000, 100000, 4000000};
+    unsigned long long state = 88172645463325252ULL;
+    long long *keys = malloc(queries * sizeof(long long));
 
-    for (long i = 0; i < totalOrders; i++)
+    printf("\n=== BENCHMARK DE BUSCA NO INDICE (%ld buscas) ===\n", queries);
+    printf("%-12s %18s %18s\n", "Entradas", "busca binaria", "eytzinger");
+
+    for (int s = 0; s < 3; s++)
     {
-        if (fread(&order, sizeof(ORDER), 1, orderHistory) != 1)
-            break;
+        SPARSE_INDEX index = {0};
+        index.count = sizes[s];
+        index.entries = malloc(index.count * sizeof(INDEX));
 
-        if (isOrderRemoved(&order))
-            continue;
+        long long id = 1924719190000000000LL;
+        for (long i = 0; i < index.count; i++)
+        {
+            id += 1 + benchRandom(&state) % 100000;
+            index.entries[i].id = id;
+            index.entries[i].position = i * 1000L * (long)sizeof(ORDER);
+        }
+        buildEytzinger(&index);
 
-        int year, month;
+        long long span = id - index.entries[0].id;
+        for (long q = 0; q < queries; q++)
+            keys[q] = index.entries[0].id + (long long)(benchRandom(&state) % (span + 1));
 
-        if (parseYearMonth(order.data, &year, &month))
+        long checksum[2] = {0, 0};
+        double times[2];
+        for (int method = 0; method < 2; method++)
         {
-            int idx = month - 1;
-
-            month_qty[idx] += order.quantity;
-            month_orders[idx]++;
-            month_revenue[idx] += (order.price_usd * order.quantity);
+            clock_t start = clock();
+            for (long q = 0; q < queries; q++)
+                checksum[method] += method == 0 ? residentLookup(&index, keys[q]) : eytzingerLookup(&index, keys[q]);
+            times[method] = elapsedMs(start) * 1000000.0 / queries;
         }
+
+        printf("%-12ld %15.1f ns %15.1f ns%s\n", index.count, times[0], times[1],
+               checksum[0] == checksum[1] ? "" : "  (ERRO: resultados diferentes)");
+
+        free(index.entries);
+        free(index.eytzKeys);
+        free(index.eytzPositions);
     }
+    printf("\n");
 
-    int best_month_index = 0;
-    for (int i = 1; i < 12; i++)
+    free(keys);
+}
+
+int detectCpuCount()
+{
+#ifdef _SC_NPROCESSORS_ONLN
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 0)
+        return (int)cpus;
+#endif
+    return 1;
+}
+
+void parseArguments(int argc, char *argv[])
+{
+    int spillDirsGiven = 0;
+
+    for (int i = 1; i < argc; i++)
     {
-        if (month_qty[i] > month_qty[best_month_index])
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
         {
-            best_month_index = i;
+            config.ingestThreads = atoi(argv[++i]);
+            if (config.ingestThreads < 1)
+                config.ingestThreads = 1;
         }
-    }
+        else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "replacement") == 0)
+                config.runStrategy = RUN_STRATEGY_REPLACEMENT;
+            else if (strcmp(argv[i], "sort") == 0)
+                config.runStrategy = RUN_STRATEGY_SORT;
+            else
+                printf("Estrategia de runs desconhecida: %s (use sort ou replacement)\n", argv[i]);
+        }
+        else if (strcmp(argv[i], "--sync-spill") == 0)
+        {
+            config.asyncSpill = 0;
+        }
+        else if (strcmp(argv[i], "--spill-dir") == 0 && i + 1 < argc)
+        {
+            // O primeiro --spill-dir valido substitui o padrao (../data); os seguintes sao somados
+            const char *dir = argv[++i];
+            struct stat st;
+            if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode) || access(dir, W_OK) != 0)
+            {
+                printf("Diretorio de spill invalido (inexistente ou sem escrita), ignorando %s\n", dir);
+                continue;
+            }
 
-    printf("\n========================================\n");
-    printf(" RESPOSTA: MES MAIS VENDIDO\n");
-    printf("========================================\n");
+            if (!spillDirsGiven)
+                config.numSpillDirs = 0;
+            spillDirsGiven = 1;
 
-    if (month_orders[best_month_index] == 0)
-    {
-        printf("Nenhum dado de vendas valido encontrado.\n\n");
-        return;
+            if (config.numSpillDirs < MAX_SPILL_DIRS)
+                config.spillDirs[config.numSpillDirs++] = dir;
+            else
+                printf("Maximo de %d diretorios de spill, ignorando %s\n", MAX_SPILL_DIRS, dir);
+        }
+        else if (strcmp(argv[i], "--rebuild") == 0)
+        {
+            config.forceRebuild = 1;
+        }
+        else if (strcmp(argv[i], "--bench-sort") == 0)
+        {
+            config.benchSort = 1;
+        }
+        else if (strcmp(argv[i], "--learned-index") == 0)
+        {
+            config.learnedIndex = 1;
+        }
+        else if (strcmp(argv[i], "--columnar") == 0)
+        {
+            config.columnar = 1;
+        }
+        else if (strcmp(argv[i], "--bench-search") == 0)
+        {
+            config.benchSearch = 1;
+        }
+        else if (strcmp(argv[i], "--fan-in") == 0 && i + 1 < argc)
+        {
+            config.mergeFanIn = atoi(argv[++i]);
+            if (config.mergeFanIn < 2)
+                config.mergeFanIn = 2;
+        }
+        else
+        {
+            printf("Argumento desconhecido: %s\n", argv[i]);
+        }
     }
-
-    printf("O mes em que mais se vende joias e:\n\n");
-    printf(" >>> %s <<<\n\n", getMonthName(best_month_index + 1));
-
-    printf("Estatisticas Agregadas:\n");
-    printf("Total de Pedidos: %d\n", month_orders[best_month_index]);
-    printf("Unidades Vendidas: %d\n", month_qty[best_month_index]);
-    printf("Receita Total: $%.2f\n", month_revenue[best_month_index]);
-    printf("========================================\n\n");
 }
 
-
-int main()
+int main(int argc, char *argv[])
 {
-    FILE *csv = openFile("../data/jewelry.csv", "r");
-    FILE *orderHistory = openFile("../data/orderHistory.dat", "wb+");
-    FILE *orderIndex = openFile("../data/orderIndex.idx", "wb+");
-    FILE *jewelryRegister = openFile("../data/jewelryRegister.dat", "wb+");
-    FILE *jewelryIndex = openFile("../data/jewelryIndex.idx", "wb+");
-    FILE *categoryRegister = openFile("../data/categoryRegister.dat", "wb+");
-    FILE *categoryIndex = openFile("../data/categoryIndex.idx", "wb+");
-    FILE *orderOverflow = openFile("../data/orderOverflow.dat", "wb+");
+    config.ingestThreads = detectCpuCount();
+    parseArguments(argc, argv);
+
+    if (config.benchSort || config.benchSearch)
+    {
+        if (config.benchSort)
+            benchmarkSort();
+        if (config.benchSearch)
+            benchmarkSearch();
+        return 0;
+    }
 
     int indexGap = 1000;
 
-    readCSVExternalSort(csv, orderHistory, orderIndex, jewelryRegister, jewelryIndex,
-                        categoryRegister, categoryIndex, indexGap);
+    if (!config.forceRebuild && validateManifest(indexGap) && loadDictionaries())
+    {
+        printf("Arquivos de dados atualizados (manifesto valido), carga do CSV ignorada.\n");
+    }
+    else
+    {
+        FILE *csv = openFile("../data/jewelry.csv", "r");
+        FILE *orderHistory = openFile("../data/orderHistory.dat", "wb+");
+        FILE *orderIndex = openFile("../data/orderIndex.idx", "wb+");
+        FILE *jewelryRegister = openFile("../data/jewelryRegister.dat", "wb+");
+        FILE *jewelryIndex = openFile("../data/jewelryIndex.idx", "wb+");
+        FILE *categoryRegister = openFile("../data/categoryRegister.dat", "wb+");
+        FILE *categoryIndex = openFile("../data/categoryIndex.idx", "wb+");
+        FILE *orderOverflow = openFile("../data/orderOverflow.dat", "wb+");
+
+        resetDictionaries();
+        int loaded = readCSVExternalSort(csv, orderHistory, orderIndex, jewelryRegister, jewelryIndex,
+                                         categoryRegister, categoryIndex, indexGap);
+
+        fclose(csv);
+        fclose(orderHistory);
+        fclose(orderIndex);
+        fclose(jewelryRegister);
+        fclose(jewelryIndex);
+        fclose(categoryRegister);
+        fclose(categoryIndex);
+        fclose(orderOverflow);
+
+        // Sem manifesto novo: a proxima execucao refaz a carga
+        if (!loaded)
+            return 1;
 
-    fclose(csv);
-    fclose(orderHistory);
-    fclose(orderIndex);
-    fclose(jewelryRegister);
-    fclose(jewelryIndex);
-    fclose(categoryRegister);
-    fclose(categoryIndex);
-    fclose(orderOverflow);
-
-    orderHistory = openFile("../data/orderHistory.dat", "rb+");
-    orderIndex = openFile("../data/orderIndex.idx", "rb+");
-    jewelryRegister = openFile("../data/jewelryRegister.dat", "rb+");
-    jewelryIndex = openFile("../data/jewelryIndex.idx", "rb+");
-    categoryRegister = openFile("../data/categoryRegister.dat", "rb+");
-    categoryIndex = openFile("../data/categoryIndex.idx", "rb+");
-    orderOverflow = openFile("../data/orderOverflow.dat", "rb+");
+        saveDictionaries();
+        saveManifest(indexGap, 1);
+    }
+
+    FILE *orderHistory = openFile("../data/orderHistory.dat", "rb+");
+    FILE *orderIndex = openFile("../data/orderIndex.idx", "rb+");
+    FILE *jewelryRegister = openFile("../data/jewelryRegister.dat", "rb+");
+    FILE *jewelryIndex = openFile("../data/jewelryIndex.idx", "rb+");
+    FILE *categoryRegister = openFile("../data/categoryRegister.dat", "rb+");
+    FILE *categoryIndex = openFile("../data/categoryIndex.idx", "rb+");
+    FILE *orderOverflow = openFile("../data/orderOverflow.dat", "rb+");
+
+    openSparseIndex(&orderSparse, "../data/orderIndex.bpt", orderIndex);
+    openSparseIndex(&jewelrySparse, "../data/jewelryIndex.bpt", jewelryIndex);
+    openSparseIndex(&categorySparse, "../data/categoryIndex.bpt", categoryIndex);
+    if (config.learnedIndex)
+        loadLearnedIndex(orderHistory, &learnedIndex);
+    openOverflowChains(&overflowChains, orderOverflow, orderIndex);
+    loadOrderBloom(orderHistory, indexGap);
+    loadProductIndex(orderHistory, orderOverflow);
+    loadOrderZones(orderHistory);
+    loadOrderBitmaps(orderHistory, orderOverflow);
+    loadColumnStore(orderHistory);
+
+    // Enquanto os arquivos estao abertos o manifesto fica "sujo": se o programa cair,
+    // a proxima execucao reconstroi tudo a partir do CSV.
+    saveManifest(indexGap, 0);
 
     int opcao = -1;
     while (opcao != 0)
@@ -1811,6 +7052,12 @@ int main()
         printf("8 - Produto mais vendido\n");
         printf("9 - Mes com mais vendas\n");
         printf("10 - Categoria mais vendida\n");
+        printf("11 - Carga incremental (CSV)\n");
+        printf("12 - Vendas de um produto\n");
+        printf("13 - Vendas por periodo / categoria / preco\n");
+        printf("14 - Contar ordens por atributos\n");
+        printf("15 - Itens de um intervalo de ordens\n");
+        printf("16 - Conferir lista de ordens (arquivo)\n");
         printf("0 - Sair\n");
         printf("======================== ==\n");
         printf("Opcao: ");
@@ -1842,12 +7089,13 @@ int main()
 
             if (result)
             {
+                char date[DATE_TEXT_SIZE];
                 printf("\n=== ORDEM ENCONTRADA ===\n");
                 printf("Order ID:    %lld\n", result->order_id);
-                printf("Data:        %s\n", result->data);
+                printf("Data:        %s\n", formatDateTime(result->date, date));
                 printf("Product ID:  %lld\n", result->product_id);
                 printf("Quantidade:  %d\n", result->quantity);
-                printf("Preco:       $%.2f\n", result->price_usd);
+                printf("Preco:       $%.2f\n", centsToUsd(result->price_cents));
                 printf("User ID:     %lld\n", result->user_id);
                 free(result);
             }
@@ -1872,10 +7120,13 @@ int main()
             printf("Quantidade: ");
             scanf("%d", &newOrder.quantity);
             printf("Preco USD: ");
-            scanf("%f", &newOrder.price_usd);
+            float price;
+            scanf("%f", &price);
+            newOrder.price_cents = (int)(price * 100.0 + 0.5);
             printf("User ID: ");
             scanf("%lld", &newOrder.user_id);
-            getCurrentDateTimeUTC(newOrder.data);
+            newOrder.date = time(NULL);
+            newOrder.status = ACTIVE_FLAG;
 
             insertOrderWithOverflow(&newOrder, orderHistory, orderIndex, orderOverflow,
                                     categoryRegister, categoryIndex, indexGap);
@@ -1893,7 +7144,7 @@ int main()
         }
 
         case 6: // Reconstruir indices
-            rebuildAllIndices(orderHistory, orderIndex, categoryRegister, categoryIndex, indexGap);
+            rebuildAllIndices(orderHistory, orderIndex, orderOverflow, categoryRegister, categoryIndex, indexGap);
 
             break;
 
@@ -1913,6 +7164,59 @@ int main()
         case 10: // Categoria mais vendida
             findBestSellingCategory(categoryRegister);
             break;
+
+        case 11: // Carga incremental de um novo lote
+        {
+            char deltaPath[256];
+            printf("Caminho do CSV: ");
+            scanf("%255s", deltaPath);
+
+            loadDeltaCSV(deltaPath, &orderHistory, &orderIndex, &jewelryRegister, &jewelryIndex,
+                         &categoryRegister, &categoryIndex, &orderOverflow, indexGap);
+            break;
+        }
+        case 12: // Vendas de um produto pelo indice secundario
+        {
+            long long productId;
+            printf("Product ID: ");
+            scanf("%lld", &productId);
+
+            showProductSales(orderHistory, orderOverflow, productId);
+            break;
+        }
+        case 13: // Consulta com filtros, pulando blocos pelas zone maps
+        {
+            ORDER_FILTER filter;
+            readOrderFilter(&filter);
+
+            scanOrdersWithFilter(orderHistory, orderOverflow, &filter);
+            break;
+        }
+        case 14: // Contagem por gender/metal/gem/color/categoria pelos bitmaps
+            queryOrderBitmaps();
+            break;
+        case 15: // Todos os itens de order_id em [lo, hi] pelo cursor
+        {
+            long long lo, hi;
+            printf("Order ID inicial: ");
+            scanf("%lld", &lo);
+            printf("Order ID final (0 = so a inicial): ");
+            scanf("%lld", &hi);
+            if (hi == 0)
+                hi = lo;
+
+            showOrderRange(orderHistory, orderIndex, orderOverflow, lo, hi);
+            break;
+        }
+        case 16: // Busca em lote dos order_id de um arquivo
+        {
+            char listPath[256];
+            printf("Arquivo com os order_id: ");
+            scanf("%255s", listPath);
+
+            reconcileOrders(orderHistory, orderIndex, orderOverflow, listPath, indexGap);
+            break;
+        }
         case 0:
             printf("Encerrando sistema...\n");
             break;
@@ -1936,6 +7240,22 @@ int main()
         fclose(categoryIndex);
     if (orderOverflow)
         fclose(orderOverflow);
+    closeSparseIndex(&orderSparse);
+    closeSparseIndex(&jewelrySparse);
+    closeSparseIndex(&categorySparse);
+    free(learnedIndex.segments);
+    closeOverflowChains(&overflowChains);
+    free(orderBloom.bits);
+    freeProductIndex(&productIndex);
+    initZoneMaps(&orderZones);
+    if (orderBitmaps.dirty)
+        saveOrderBitmaps(&orderBitmaps);
+    freeOrderBitmaps(&orderBitmaps);
+    closeColumnStore(&columnStore);
+    if (dictionaries.dirty)
+        saveDictionaries();
+
+    saveManifest(indexGap, 1);
 
     printf("\nSistema encerrado.\n");
     return 0;